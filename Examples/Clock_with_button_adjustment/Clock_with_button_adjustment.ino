@@ -26,12 +26,16 @@
  *    This file is an example of how to use the clock mode, and the background
  *    rgb colour fading. 
  *    
- *    The main loop uses the millis() function to time a second, and updates the 
- *    time on the Nixie Tube Driver, whilst fading a rainbow colour pattern in the 
+ *    The library keeps the time in the background and updates the Nixie Tube 
+ *    Driver every second, whilst fading a rainbow colour pattern in the 
  *    background.
  *    
- *    The example also includes a function to set the time, using a three push-
- *    button interface. 
+ *    The example also shows how to set the time, using a three push-button 
+ *    interface. Nothing waits for the buttons, so the clock keeps running 
+ *    while the time is being set. 
+ *    
+ *    Once set, the clock and backlight are saved to EEPROM and put back at the
+ *    next power up, carrying on from the time that was saved.
  *    
  *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
  * Hardware setup:
@@ -70,9 +74,6 @@
 
 #include <NixieDriver.h>
 
-//Macro to wait for a debounce
-#define Debounce() delay(100)
-
 //Pin assignments for backlight pins
 const int redPin = 3;
 const int greenPin = 5;
@@ -88,8 +89,14 @@ const int up_button = 11;
 const int sel_button = 12;
 const int down_button = 13;
 
+//Button numbers, in the order given to buttons
+#define UP 0
+#define SELECT 1
+#define DOWN 2
+
 nixie nixie(data, clock, oe);
 backlight rgb(redPin, greenPin, bluePin);
+buttons buttons(up_button, sel_button, down_button);
 
 //Create a background colour cycle
 int colourCycle[8][4] = {
@@ -103,11 +110,6 @@ int colourCycle[8][4] = {
   {ENDCYCLE}      //Declare the end of the loop
 };
 
-//define the initial time
-  int h;
-  int m;
-  int s;
-
 /*************************************************************************************
  * Name:    setup(void)
  * Inputs:  None
@@ -118,10 +120,8 @@ void setup() {
   //Begin serial comms
   Serial.begin(9600);
 
-  //Assign buttons
-  pinMode(up_button,INPUT);
-  pinMode(sel_button,INPUT);
-  pinMode(down_button,INPUT);
+  //Carry on from the last time the time was set, if it has been
+  if(nixie.restoreConfig(&rgb)) return;
 
   //Attempt to begin fade
   if(!rgb.setFade(colourCycle, 1000)) 
@@ -133,10 +133,8 @@ void setup() {
   
   nixie.setClockMode(1);    //set clock mode on
   
-  nixie.setTime(__TIME__);//set the time to the compile time
-  h = nixie.hours;          //update variables
-  m = nixie.minutes;
-  s = nixie.seconds;
+  nixie.setTime(__TIME__);  //set the time to the compile time
+  nixie.setTimekeeping(1);  //and keep it running in the background
 }
 
 /*************************************************************************************
@@ -147,114 +145,32 @@ void setup() {
  ************************************************************************************/
 void loop() {
 
-  //record the current time
-  uint32_t currentTime = millis(); 
-
-  //do we want to change the time
-  if(digitalRead(sel_button))
-  SetNewTime();
-
-  //wait until a second has passed
-  while(millis()-currentTime<1000);
+  uint8_t button, event;
 
-  //update the time
-  nixie.updateTime();
-  if (m == 59 && s == 59) h = (h == 23) ? 0 : h + 1;  //If we need to update hours, wrap around 23
-  if (s == 59) m = (m == 59) ? 0 : m + 1;             //If we need to update minutes, wrap around 59
-  s = (s == 59) ? 0 : s + 1;                          //Always update seconds and wrap round 59
-  nixie.setTime(h, m, s);
+  nixie.update(); //let the library do its background work
 
-}
-  
+  //handle any button presses
+  while(buttons.getEvent(&button, &event))
+  {
+    if(event == BUTTON_RELEASE || event == BUTTON_LONG_PRESS) continue; //not used here
 
-/*************************************************************************************
- * Name:    SetNewTime(void)
- * Inputs:  None
- * Outputs: None
- * Desc:    Performs the setting of the time. Using an up/down/select buutton set. 
- ************************************************************************************/
-void SetNewTime()
-{
-      Debounce();
-      rgb.setColour(rgb.white);       //change the backlight so it's obvious we're here
-      while(digitalRead(sel_button)); //wait for user to let go of set button to stop code running away
-      
-            
-      nixie.setTime(h, BLANK, BLANK);         //display only the hours to the user
-      nixie.updateTime(); 
-      while(!digitalRead(sel_button)) //enter setting mode until hours are set
+    if(nixie.getEditField() == FIELD_NONE)
+    {
+      if(button == SELECT && event == BUTTON_PRESS) //start setting the time
       {
-        if(digitalRead(up_button))    //increment when up button pressed
-        {
-          Debounce();
-          if(h==23) h=0; else h++;
-          nixie.setTime(h, BLANK, BLANK);
-          nixie.updateTime();
-          delay(250);
-        }
-        if(digitalRead(down_button))  //decrement when down button pressed
-        {
-          Debounce();
-          if(h==0) h=23; else h--;
-          nixie.setTime(h, BLANK, BLANK);
-          nixie.updateTime();
-          delay(250);
-        }
+        rgb.stopFade(rgb.white, 0);   //change the backlight so it's obvious we're here
+        nixie.startTimeEdit();
       }
-      
-      while(digitalRead(sel_button)); //wait for user to let go of set button to stop code running away
-                                  
-      nixie.setTime(BLANK,m,BLANK);           //display only the minutes to the user
-      nixie.updateTime();
-      while(!digitalRead(sel_button)) //enter setting mode until minutes are set  
-      {
-        if(digitalRead(up_button))    //increment when up button pressed
-        {
-          Debounce();
-          if(m==59) m=0; else m++;
-          nixie.setTime(BLANK, m, BLANK); 
-          nixie.updateTime();
-          delay(250);
-        }
-        if(digitalRead(down_button))  //decrement when down button pressed
-        {
-          Debounce();
-          if(m==0) m=59; else m--;
-          nixie.setTime(BLANK, m, BLANK);
-          nixie.updateTime();
-          delay(250);
-        }
-      }     
-      
-      while(digitalRead(sel_button)); //wait for user to let go of set button to stop code running away
-                                        
-      nixie.setTime(BLANK,BLANK,s);           //display only the seconds to the user
-      nixie.updateTime();
-      while(!digitalRead(sel_button)) //enter setting mode until seconds are set 
+    }
+    else if(button == SELECT)
+    {
+      if(event == BUTTON_PRESS && !nixie.editTime(EDIT_SELECT)) //move on to the next field
       {
-        if(digitalRead(up_button))    //increment when up button pressed
-        {
-          Debounce();
-          if(s==59) s=0; else s++;
-          nixie.setTime(BLANK, BLANK, s);
-          nixie.updateTime();
-          delay(250);
-        }
-        if(digitalRead(down_button))  //decrement when down button pressed
-        {
-          Debounce();
-          if(s==0) s=59; else s--;
-          nixie.setTime(BLANK, BLANK, s);
-          nixie.updateTime();
-          delay(250);
-        }
+        rgb.setFade(colourCycle, 1000); //return the backlight to the running mode once done
+        nixie.saveConfig(&rgb);         //and remember it all for next time
       }
-      rgb.setFade(colourCycle, 1000);       //return the backlight to the running mode
-      while(digitalRead(sel_button)); //wait for the button to be let up before returning to the main program
     }
-
-  
-   
-
-  
-
+    else //up and down repeat when held
+      nixie.editTime(button == UP ? EDIT_UP : EDIT_DOWN);
+  }
+}
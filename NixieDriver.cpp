@@ -24,112 +24,186 @@
  ************************************************************************************/
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <avr/eeprom.h>
 #include <Arduino.h>
 #include <NixieDriver.h>
 #include <util/delay.h>
+#include <util/crc16.h>
 
 /*************************************************************************************
  * Definitions
  ************************************************************************************/
-#define FADE_RESOLUTION 256 //the number of increments between fades
+#define TICK_US clockCyclesToMicroseconds(64 * 256) //time between timer 0 overflows
+
+#define MIN_TICK_COUNTS 100 //timer counts the fade ISR is given to finish before the next
+
+#define FADE_MIN_TICKS 16 //fewest ticks per step when the rate is capped
+#define FADE_MAX_SHIFT 2 //most ticks per step is FADE_RESOLUTION << this, between table points
+
+#define RETIRED_NODES 4 //removed fade steps that can be waiting to be freed
+
+#define RTC_ADDRESS 0x68 //DS3231 and DS1307
+#define RTC_TWI_HZ 100000 //the DS1307 only does 100kHz
+
+#define RTC_IDLE 0 //rtc bus states
+#define RTC_START 1 //start sent, waiting to send the address
+#define RTC_WRITE 2 //sending bytes
+#define RTC_READ 3 //receiving bytes
+
+#define twi_go(extra) TWCR = (1 << TWINT) | (1 << TWEN) | (extra)
+
+#define REMOTE_IDLE 0 //remote parser states
+#define REMOTE_TEXT 1
+#define REMOTE_LENGTH 2
+#define REMOTE_PAYLOAD 3
+#define REMOTE_CHECK 4
+#define REMOTE_SKIP 5 //rest of a line that didn't fit
+
+#define REMOTE_ACK 0x06
+#define REMOTE_NAK 0x15
+
+#define EDIT_FLASH_MS 250 //on and off time of the field being edited
+
+#define BUTTON_INTEGRATOR 20 //ticks a button has to settle for, about 20ms
+
+#define NO_SIGN 0xFF //displayNumber() of an unsigned number
+
+#define SCROLL_BLANK 0x0F //glyph for a blank tube
+#define SCROLL_DP 0x80 //glyph flag for a decimal point
+
+#define USAGE_MAGIC 0xA5 //marks a usage slot as holding a complete log
+#define USAGE_IDLE 0xFF //flushStep value when no flush is in progress
+#define USAGE_SLOT_SIZE (2 + 6 * 10 * sizeof(uint16_t)) //magic, sequence, counters
+
+#define CONFIG_SLOT_SIZE (1 + sizeof(nixie::ConfigType_t) + 2) //sequence, config, CRC
+
+#define CONFIG_CLOCK_MODE 0x01 //config flags
+#define CONFIG_TIMEKEEPING 0x02
+#define CONFIG_FADING 0x04
+
+#if USAGE_SLOTS < 2
+#error "USAGE_SLOTS must be at least 2 so the previous log survives a flush"
+#endif
 
 /*************************************************************************************
  * Macros
  ************************************************************************************/
-#define load_timer1_count(val) uint8_t oldSREG = SREG; 	\
-							   cli(); 				   	\
-							   TCNT1 = (val);    		\
-							   SREG = oldSREG
+#define fade_running() (TIMSK1 & (1 << OCIE1A))
+
+#ifdef FADE_TRACE_PIN //see NixieDriver.h
+#define fade_trace_setup() pinMode(FADE_TRACE_PIN, OUTPUT)
+#define fade_trace(state) digitalWrite(FADE_TRACE_PIN, state)
+#else
+#define fade_trace_setup()
+#define fade_trace(state)
+#endif
+
+#ifdef TICK_TRACE_PIN
+#define tick_trace_setup() pinMode(TICK_TRACE_PIN, OUTPUT)
+#define tick_trace(state) digitalWrite(TICK_TRACE_PIN, state)
+#else
+#define tick_trace_setup()
+#define tick_trace(state)
+#endif
 
 /*************************************************************************************
  * Globals
  ************************************************************************************/
 
-//nixie variables
-uint8_t _dataPin;
-uint8_t _clockPin;
-uint8_t _outputEnablePin;
-uint8_t _strobePin;
-uint16_t _dpMask = 0x0; //mask for the decimal points
-bool _clockModeEnable = 0;
-uint8_t _symbolMask[6] = {0,0,0,0,0,0}; //for each nixie (0 = NONE, 1 = IN15A, 2 = IN15B)
-uint8_t _symbols[6] = {BLANK,BLANK,BLANK,BLANK,BLANK,BLANK};
-uint8_t _symbolDivisor = 1;
-
-//clock mode variables
-long hours = 0;
-long minutes = 0;
-long seconds = 0;
-
 //backlight variables
 volatile uint8_t _pins[3]; //holds the pin declarations
-volatile uint8_t currentColour[3] = {0,0,0}; //accesable from outside the library
+const uint8_t *_calibration[3] = {NULL, NULL, NULL}; //output table for each pin, in PROGMEM
+uint8_t _outputMode = PWM_8BIT;
+volatile uint8_t *_ocr8[3]; //8 bit duty register for each pin, looked up once in the constructor
+volatile uint16_t *_ocr16[3] = {NULL, NULL, NULL}; //16 bit duty register for each pin, if it has one
+volatile uint8_t _noPwm; //written to in place of a duty register for pins without PWM
+uint8_t _dither[3] = {0, 0, 0}; //fraction carried to the next tick on 8 bit pins
+void (*_output[3])(uint8_t channel, uint16_t level); //output routine for each pin, picked by selectOutput()
 volatile uint8_t currentFadeColour[3] = {0,0,0}; //not accesable from outside the library
 volatile uint16_t timerCount; //incremented on each timer call
 backlight::CycleType_t *currentNode;
+backlight::CycleType_t *nextNode; //latched at the start of each segment
 backlight::CycleType_t *entry;
-volatile uint16_t TIM1Preload = 0;
-
-void* pt2object; //used to access backlight functions from outside the class
-backlight* bl = (backlight*) pt2object;
+backlight::CycleType_t *pendingEntry = NULL; //new program waiting for the end of a segment
+backlight::CycleType_t *retiredEntry = NULL; //old program waiting to be freed
+backlight::CycleType_t *retired[RETIRED_NODES]; //removed steps waiting to be freed
+volatile uint16_t _tickCounts; //timer counts per fade tick, rounded down
+volatile uint16_t _tickExtra; //ticks per step which need one more count
+volatile uint16_t _tickError = 0; //how far through the next extra count we are
+uint8_t _halfUsCarry = 0; //half us that didn't make a whole count, carried to the next step
+uint8_t _periodShift = 0; //the timer period is 0.5us shifted left by this
+uint16_t _segmentTicks = FADE_RESOLUTION; //ticks in the current step
+int8_t _tickShift = 0; //_segmentTicks is FADE_RESOLUTION shifted left by this
+uint16_t _maxTickRate = 0; //cap on fade interrupts per second, 0 for a fixed rate
+volatile uint32_t _tickRate = 0; //fade interrupts per second in the current step
+uint8_t currentStep; //step of the loop currentNode is, or FADE_IN_STEP
+backlight::FadeCallback_t _fadeCallback[FADE_EVENTS] = {NULL, NULL, NULL};
+volatile uint8_t _fadeEvents[FADE_EVENT_QUEUE_SIZE][2]; //event, step
+volatile uint8_t _fadeEventHead = 0;
+volatile uint8_t _fadeEventCount = 0;
+uint8_t _syncUnit = SYNC_OFF; //what the fade durations are counted in
+volatile uint16_t _syncRemaining; //clock units left in the current step when synced
+const uint32_t PROGMEM syncUnitMs[4] = {1, 1000, 60000, 3600000};
+
+nixie *nx = NULL; //the nixie serviced by the shared tick
+
+backlight* bl = NULL; //used to access backlight functions from outside the class
+
+buttons *bt = NULL; //the buttons serviced by the shared tick
+
+rtc *rt = NULL; //the rtc serviced by the shared tick and the square wave interrupt
 
 /* Colours - see NixieDriver.h for values */
-int backlight::black[3]  = 		{	BLACK	  };
-int backlight::white[3]  = 		{ 	WHITE     };
-int backlight::red[3]    = 		{ 	RED  	  };
-int backlight::green[3]  = 		{ 	GREEN	  };
-int backlight::blue[3]   = 		{	BLUE      };
-int backlight::yellow[3] = 		{ 	YELLOW 	  };
-int backlight::dimWhite[3] = 	{ 	DIMWHITE  };
-int backlight::aqua[3] = 		{ 	AQUA      };
-int backlight::magenta[3] = 	{	MAGENTA   };
-int backlight::purple[3]= 		{	PURPLE    };
+const backlight::NamedColour_t backlight::black PROGMEM = 		{{	BLACK	  }};
+const backlight::NamedColour_t backlight::white PROGMEM = 		{{ 	WHITE     }};
+const backlight::NamedColour_t backlight::red PROGMEM = 		{{ 	RED  	  }};
+const backlight::NamedColour_t backlight::green PROGMEM = 		{{ 	GREEN	  }};
+const backlight::NamedColour_t backlight::blue PROGMEM = 		{{	BLUE      }};
+const backlight::NamedColour_t backlight::yellow PROGMEM = 		{{ 	YELLOW 	  }};
+const backlight::NamedColour_t backlight::dimWhite PROGMEM = 	{{ 	DIMWHITE  }};
+const backlight::NamedColour_t backlight::aqua PROGMEM = 		{{ 	AQUA      }};
+const backlight::NamedColour_t backlight::magenta PROGMEM = 	{{	MAGENTA   }};
+const backlight::NamedColour_t backlight::purple PROGMEM = 		{{	PURPLE    }};
 
 
-/* Holds the curve y = 32768 * (-cos(pi * x / 256) + 1) between 0 and 256
+/* Holds the curve y = 32768 * (-cos(pi * x / N) + 1) between 0 and N, where N is
+ * FADE_RESOLUTION - see FadeCurve in NixieDriver.h.
  *
  * This is useful as if you mix colours using this function over time the
  * fade appears much more natural than a simple linear fade.
- *
- * The PROGMEM keyword forces variable into program memory as opposed to
- * RAM, increasing available RAM for user.
  */
-const uint16_t PROGMEM cosFade[256] =
-{
-    0, 0, 0, 65, 65, 65, 131, 131, 196,
-	262, 262, 327, 393, 458, 524, 589, 720,
-	786, 851, 983, 1048, 1179, 1245, 1376, 1507,
-	1638, 1769, 1900, 2031, 2162, 2293, 2490, 2621,
-	2752, 2949, 3145, 3276, 3473, 3669, 3866, 3997,
-	4194, 4456, 4652, 4849, 5046, 5242, 5504, 5701,
-	5963, 6160, 6422, 6684, 6881, 7143, 7405, 7667,
-	7929, 8191, 8454, 8716, 8978, 9305, 9568, 9830,
-	10157, 10420, 10747, 11009, 11337, 11665, 11927, 12255,
-	12582, 12910, 13238, 13565, 13893, 14221, 14548, 14876,
-	15204, 15531, 15859, 16252, 16580, 16908, 17301, 17628,
-	18022, 18349, 18743, 19070, 19463, 19857, 20184, 20577,
-	20971, 21298, 21692, 22085, 22478, 22871, 23264, 23592,
-	23985, 24379, 24772, 25165, 25558, 25951, 26345, 26738,
-	27131, 27524, 27917, 28376, 28769, 29163, 29556, 29949,
-	30342, 30735, 31129, 31587, 31981, 32374, 32767, 33160,
-	33553, 33947, 34405, 34799, 35192, 35585, 35978, 36371,
-	36765, 37158, 37617, 38010, 38403, 38796, 39189, 39583,
-	39976, 40369, 40762, 41155, 41549, 41942, 42270, 42663,
-	43056, 43449, 43842, 44236, 44563, 44957, 45350, 45677,
-	46071, 46464, 46791, 47185, 47512, 47906, 48233, 48626,
-	48954, 49282, 49675, 50003, 50330, 50658, 50986, 51313,
-	51641, 51969, 52296, 52624, 52952, 53279, 53607, 53869,
-	54197, 54525, 54787, 55114, 55377, 55704, 55966, 56229,
-	56556, 56818, 57080, 57343, 57605, 57867, 58129, 58391,
-	58653, 58850, 59112, 59374, 59571, 59833, 60030, 60292,
-	60488, 60685, 60882, 61078, 61340, 61537, 61668, 61865,
-	62061, 62258, 62389, 62585, 62782, 62913, 63044, 63241,
-	63372, 63503, 63634, 63765, 63896, 64027, 64158, 64289,
-	64355, 64486, 64551, 64683, 64748, 64814, 64945, 65010,
-	65076, 65141, 65207, 65272, 65272, 65338, 65403, 65403,
-	65469, 65469, 65469, 65535, 65535, 65535, 65535
+const uint16_t *const cosFade = EASE_COSINE;
+
+/* The built in curves by CURVE_ number, so a saved fade can be put back on them */
+const uint16_t *const fadeCurves[] PROGMEM = {
+	EASE_COSINE, EASE_LINEAR, EASE_QUADRATIC, EASE_EXPONENTIAL, EASE_PERCEPTUAL
+};
+#define FADE_CURVES (sizeof(fadeCurves) / sizeof(fadeCurves[0]))
+
+/* Wiring of the Doayee Nixie Tube Driver - digit 0 is on output 9 and digit n on
+ * output n-1, tubes are in order along the chain and the decimal points for tubes
+ * 0 -> 5 are on bits 7 -> 2.
+ */
+const nixie::BoardProfile_t nixie::doayeeBoard PROGMEM =
+{
+	CATHODE_MAP(9, 0, 1, 2, 3, 4, 5, 6, 7, 8),
+	{ 0, 1, 2, 3, 4, 5 },
+	{ 7, 6, 5, 4, 3, 2 }
+};
+
+/* Powers of ten that fit in 32 bits, used to pick digits out of a number */
+const uint32_t PROGMEM powersOfTen[10] =
+{
+	1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL,
+	1000000UL, 10000000UL, 100000000UL, 1000000000UL
 };
 
+/* Where each stopwatch digit wraps, h h m m s s 1/10 1/100 */
+const uint8_t PROGMEM watchLimit[8] = { 10, 10, 6, 10, 6, 10, 10, 10 };
+
+/* The IN-15A symbol for each SI prefix from pico (10^-12) to mega (10^6) */
+const uint8_t PROGMEM siPrefix[7] = { PICO, NANO, MICRO, MILLI, BLANK, KILO, MEGA };
+
 /*************************************************************************************
  * Nixie Class
  ************************************************************************************/
@@ -148,6 +222,7 @@ const uint16_t PROGMEM cosFade[256] =
  ************************************************************************************/
 nixie::nixie(int data, int clk, int oe, int srb)
 {
+	_profile = &doayeeBoard;
 	setDataPin(data); //set up pins
 	setClk(clk);
 	setOE(oe);
@@ -168,6 +243,7 @@ nixie::nixie(int data, int clk, int oe, int srb)
  ************************************************************************************/
 nixie::nixie(int data, int clk, int oe)
 {
+	_profile = &doayeeBoard;
 	setDataPin(data); //set up pins
 	setClk(clk);
 	setOE(oe);
@@ -186,6 +262,7 @@ nixie::nixie(int data, int clk, int oe)
  ************************************************************************************/
 nixie::nixie(int data, int clk)
 {
+	_profile = &doayeeBoard;
 	setDataPin(data); //set up pins
 	setClk(clk);
 	startupTransmission();
@@ -216,6 +293,7 @@ nixie::~nixie()
 void nixie::startupTransmission(void)
 {
 	uint16_t data[6] = {0x0,0x0,0x0,0x0,0x0,0x0};
+	tick_trace_setup();
 	shift(data);
 	shift(data);
 	for(uint8_t i = 0; i < 6; i++)
@@ -308,13 +386,32 @@ void nixie::transmit(bool data)
  *
  * Returns: None.
  *
- * Desc:	Shifts out all data to the HV5122s.
+ * Desc:	Shifts out all data to the HV5122s, with the decimal points in _dpMask.
  ************************************************************************************/
 void nixie::shift(uint16_t data[])
+{
+  shift(data, _dpMask);
+}
+
+/*************************************************************************************
+ * Name: 	shift(const uint16_t data[], uint8_t decimalPoints)
+ *
+ * Params:	const uint16_t[] data - array containing the bits to shift out (for the
+ * 									numbers only) - must be 6 elements long.
+ * 			uint8_t decimalPoints - the decimal point byte to shift out with them
+ *
+ * Returns: None.
+ *
+ * Desc:	Shifts out all data to the HV5122s. This is 68 bits of three digitalWrite()
+ * 			calls each, about 1ms at 16MHz with the tubes dark for most of it. It is
+ * 			never called from an interrupt - the shared tick leaves its frames for
+ * 			update() - so millis() and the fades carry on while it runs.
+ ************************************************************************************/
+void nixie::shift(const uint16_t data[], uint8_t decimalPoints)
 {
   blank(1);
   for(uint8_t i = 0; i < 8; i++)  //for the decimal points
-	  transmit(_dpMask & (1 << i));
+	  transmit(decimalPoints & (1 << i));
   for (int8_t i = 5; i >= 0; i--) //for all 6 tubes
   {
     for (int8_t j = 9; j >= 0; j--) //for all 10 segments
@@ -323,9 +420,57 @@ void nixie::shift(uint16_t data[])
       transmit(toShift); //send the data
     }
   }
+  memcpy((void *)_frame, (const void *)data, sizeof(_frame)); //remember what is lit
+  _framePoints = decimalPoints;
   blank(0);
 }
 
+/*************************************************************************************
+ * Name: 	postFrame(const uint16_t data[], uint8_t decimalPoints)
+ *
+ * Params:	const uint16_t[] data - the bits to shift out, must be 6 elements long
+ * 			uint8_t decimalPoints - the decimal point byte to shift out with them
+ *
+ * Returns: None.
+ *
+ * Desc:	Leaves a frame for update() to shift out. Used by everything the shared
+ * 			tick shows, so the tick never spends a whole shift() in the interrupt. A
+ * 			frame not yet shown is replaced by the newer one.
+ ************************************************************************************/
+void nixie::postFrame(const uint16_t data[], uint8_t decimalPoints)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	memcpy((void *)_dueFrame, (const void *)data, sizeof(_dueFrame));
+	_duePoints = decimalPoints;
+	_frameDue = 1;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	showDue(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Shifts out the frame left by postFrame(), if there is one.
+ ************************************************************************************/
+void nixie::showDue(void)
+{
+	if(!_frameDue) return;
+
+	uint16_t data[6];
+	uint8_t oldSREG = SREG;
+	cli();
+	memcpy((void *)data, (const void *)_dueFrame, sizeof(data));
+	uint8_t decimalPoints = _duePoints;
+	_frameDue = 0;
+	SREG = oldSREG;
+
+	shift(data, decimalPoints);
+}
+
 /*************************************************************************************
  * Name: 	displayDigits(int a, int b, int c, int d, int e, int f)
  *
@@ -338,19 +483,417 @@ void nixie::shift(uint16_t data[])
 void nixie::displayDigits(int a, int b, int c, int d, int e, int f)
 {
   uint8_t numbers[6] = {(uint8_t)a,(uint8_t)b, (uint8_t)c, (uint8_t)d, (uint8_t)e, (uint8_t)f};
-  uint16_t data[6] = {0x0, 0x0, 0x0, 0x0, 0x0, 0x0};
+  displayDigits(numbers);
+}
+
+/*************************************************************************************
+ * Name: 	displayDigits(const uint8_t digits[])
+ *
+ * Params:	const uint8_t digits[] - the digits to be displayed on each tube, must be
+ * 									 6 elements long
+ *
+ * Returns: None.
+ *
+ * Desc:	Displays a number, digits specified as an array.
+ ************************************************************************************/
+void nixie::displayDigits(const uint8_t digits[])
+{
+  uint16_t data[6];
+  encode(digits, data);
+  _frameDue = 0; //anything the shared tick left is older than this
+  shift(data);
+}
+
+/*************************************************************************************
+ * Name: 	encode(const uint8_t digits[], uint16_t data[])
+ *
+ * Params:	const uint8_t digits[] - the digit for each tube, anything over 9 is blank
+ * 			uint16_t data[] - filled with the bits to shift out, in chain order
+ *
+ * Returns: None.
+ *
+ * Desc:	Converts digits into output bits using the board profile.
+ ************************************************************************************/
+void nixie::encode(const uint8_t digits[], uint16_t data[])
+{
   for (uint8_t i = 0; i < 6; i++) //for each tube
   {
-    if(numbers[i] >= 10)
+    uint8_t position = pgm_read_byte(&_profile->tube[i]);
+    data[position] = (digits[i] < 10) ? pgm_read_word(&_profile->cathode[digits[i]]) : 0x0; //blank if not a digit
+  }
+}
+
+/*************************************************************************************
+ * Name: 	encodeFrame(const uint8_t digits[], Frame_t *frame)
+ *
+ * Params:	const uint8_t digits[] - the digit for each tube, must be 6 elements long
+ * 			Frame_t *frame - the frame to fill
+ *
+ * Returns: None.
+ *
+ * Desc:	Builds a frame from digits and the current decimal points, so that it can
+ * 			be shown later without any further work. The dwell is left untouched.
+ ************************************************************************************/
+void nixie::encodeFrame(const uint8_t digits[], Frame_t *frame)
+{
+	encode(digits, frame->tube);
+	frame->decimalPoints = _dpMask;
+}
+
+/*************************************************************************************
+ * Name: 	displayFrame(const Frame_t *frame)
+ *
+ * Params:	const Frame_t *frame - the frame to show
+ *
+ * Returns: None.
+ *
+ * Desc:	Shifts out a pre-encoded frame as it is, including its decimal points. The
+ * 			decimal points set with setDecimalPoint() are left as they were.
+ ************************************************************************************/
+void nixie::displayFrame(const Frame_t *frame)
+{
+	_frameDue = 0; //anything the shared tick left is older than this
+	shift(frame->tube, frame->decimalPoints);
+}
+
+/*************************************************************************************
+ * Name: 	queueFrames(const Frame_t frames[], uint8_t count)
+ *
+ * Params:	const Frame_t frames[] - the frames to queue, in order
+ * 			uint8_t count - the number of frames
+ *
+ * Returns: uint8_t - the number of frames queued, fewer than count if the queue fills.
+ *
+ * Desc:	Adds frames to the queue. Each is shown for its dwell time before moving
+ * 			on to the next, the last frame stays on the tubes. The shared tick times
+ * 			the dwells and update() shifts each frame out, so call that from loop() at
+ * 			least as often as the shortest dwell or frames will be skipped.
+ ************************************************************************************/
+uint8_t nixie::queueFrames(const Frame_t frames[], uint8_t count)
+{
+	uint8_t queued = 0;
+	while(queued < count && _frameCount < FRAME_QUEUE_SIZE)
 	{
-		data[i] = 0x0;
+		uint8_t tail = (_frameHead + _frameCount) & (FRAME_QUEUE_SIZE - 1);
+		memcpy((void *)&_frameQueue[tail], (void *)&frames[queued++], sizeof(Frame_t));
+
+		uint8_t oldSREG = SREG;
+		cli();
+		_frameCount++;
+		SREG = oldSREG;
 	}
-    else if (numbers[i] != 0) 
-      data[i] = (1 << ((numbers[i]) - 1)) ; //flip the correct bit
-    else
-      data[i] = (1 << 9); 
-  }
-  shift(data);
+
+	/* start the shared tick */
+	nx = this;
+	TIMSK0 |= (1 << OCIE0A);
+
+	return queued;
+}
+
+/*************************************************************************************
+ * Name: 	framesQueued(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint8_t - the number of frames waiting to be shown.
+ *
+ * Desc:	Used to keep the queue topped up with longer animations.
+ ************************************************************************************/
+uint8_t nixie::framesQueued(void)
+{
+	return _frameCount;
+}
+
+/*************************************************************************************
+ * Name: 	clearFrames(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Drops any frames waiting to be shown, the current frame stays on the tubes.
+ ************************************************************************************/
+void nixie::clearFrames(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	_frameCount = 0;
+	_frameDwell = 0;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	tick(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Called from the shared tick, once per timer 0 overflow (1.024ms at 16MHz).
+ * 			Moves on the frame queue, scrolling, the clock, the stopwatch and the time
+ * 			editor, leaving any new frame for update(), and counts the time the tubes
+ * 			are lit for usage tracking.
+ ************************************************************************************/
+void nixie::tick(void)
+{
+	/* work out how many whole ms have passed */
+	uint8_t elapsed = 0;
+	_tickFraction += TICK_US;
+	while(_tickFraction >= 1000)
+	{
+		_tickFraction -= 1000;
+		elapsed++;
+	}
+
+	/* cathode usage */
+	if(_usage != NULL) accountUsage(elapsed);
+
+	/* frame queue */
+	if(_frameDwell > elapsed)
+		_frameDwell -= elapsed;
+	else if(_frameCount)
+	{
+		Frame_t *frame = &_frameQueue[_frameHead];
+		postFrame(frame->tube, frame->decimalPoints);
+		_frameDwell = frame->dwell;
+		_frameHead = (_frameHead + 1) & (FRAME_QUEUE_SIZE - 1);
+		_frameCount--;
+	}
+	else
+		_frameDwell = 0;
+
+	/* scrolling */
+	if(_scrollTimer > elapsed)
+		_scrollTimer -= elapsed;
+	else if(_scrollTrail)
+	{
+		_scrollTimer = _scrollSpeed;
+		scrollStep();
+	}
+
+	/* timekeeping */
+	if(_timekeeping)
+	{
+		_clockMs += elapsed;
+		if(_clockMs >= 1000)
+		{
+			_clockMs -= 1000;
+			passSecond(advanceClock());
+		}
+	}
+
+	/* stopwatch */
+	if(_watchMode && !_watchPaused)
+	{
+		int8_t changed = 8;
+		_watchMs += elapsed;
+		while(_watchMs >= 10 && !_watchPaused)
+		{
+			_watchMs -= 10;
+			int8_t from = stepWatch();
+			if(from < changed) changed = from;
+		}
+		if(changed < 8) showWatch(changed);
+	}
+
+	/* flash the field being edited */
+	if(_editField)
+	{
+		if(_editTimer > elapsed)
+			_editTimer -= elapsed;
+		else
+		{
+			_editTimer = EDIT_FLASH_MS;
+			_editBlink = !_editBlink;
+			showEdit();
+		}
+	}
+}
+
+/*************************************************************************************
+ *------------------------------ Scrolling Overview ---------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	Digits to scroll are held in a ring buffer of glyphs. A glyph is the cathode to
+ *	light (0-9, or SCROLL_BLANK) with SCROLL_DP set if the tube's decimal point is
+ *	on. Symbols are stored as their cathode, so they show correctly when they pass
+ *	across an IN-15 tube of the right type.
+ *
+ *	Every _scrollSpeed ms the shared tick moves _scrollWindow (what is on the tubes)
+ *	one place to the left and takes the next glyph from the buffer onto the right
+ *	hand tube, leaving the frame for update() to shift out. Once the buffer is empty, blanks are moved on until the last glyph has
+ *	gone off the left hand side, after which scrolling stops. _scrollTrail counts
+ *	the steps left before this happens.
+ *
+ *	The buffer can be topped up while scrolling, using scrollSpace() to see how much
+ *	room is left.
+ *
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	scroll(const char *text)
+ *
+ * Params:	const char *text - the text to scroll, made up of digits, '.' for a
+ * 							   decimal point and anything else for a blank tube
+ *
+ * Returns: uint8_t - the number of characters taken, less than the length of text
+ * 			if the buffer is full.
+ *
+ * Desc:	Adds text to be scrolled across the tubes in the background.
+ ************************************************************************************/
+uint8_t nixie::scroll(const char *text)
+{
+	const char *start = text;
+	while(*text)
+	{
+		const char *next = text;
+		uint8_t glyph = SCROLL_BLANK;
+		if(*next >= '0' && *next <= '9') glyph = *next++ - '0';
+		else if(*next != '.') next++; //a decimal point on its own gets a blank tube
+		if(*next == '.')
+		{
+			glyph |= SCROLL_DP;
+			next++;
+		}
+
+		if(!pushGlyph(glyph)) break;
+		text = next;
+	}
+	return text - start;
+}
+
+/*************************************************************************************
+ * Name: 	scrollSymbol(int symbol, bool dp)
+ *
+ * Params:	int symbol - the symbol to scroll, as passed to setSymbol()
+ * 			bool dp - the decimal point state
+ *
+ * Returns: Bool - false if the buffer is full.
+ *
+ * Desc:	Adds a single IN-15 symbol (or a digit) to be scrolled across the tubes.
+ ************************************************************************************/
+bool nixie::scrollSymbol(int symbol, bool dp)
+{
+	uint8_t glyph = SCROLL_BLANK;
+	if(symbol >= 0 && symbol < 10) glyph = symbol;
+	else if(symbol >= 10 && symbol < 20) glyph = symbol - 10; //IN-15B
+	if(dp) glyph |= SCROLL_DP;
+	return pushGlyph(glyph);
+}
+
+/*************************************************************************************
+ * Name: 	setScrollSpeed(uint16_t ms)
+ *
+ * Params:	uint16_t ms - the time each step of the scroll is shown for
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets how quickly text scrolls across the tubes.
+ ************************************************************************************/
+void nixie::setScrollSpeed(uint16_t ms)
+{
+	_scrollSpeed = ms;
+}
+
+/*************************************************************************************
+ * Name: 	scrollSpace(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint8_t - the number of glyphs that can still be added.
+ *
+ * Desc:	Used to keep long text topped up while it scrolls.
+ ************************************************************************************/
+uint8_t nixie::scrollSpace(void)
+{
+	return SCROLL_BUFFER_SIZE - _scrollCount;
+}
+
+/*************************************************************************************
+ * Name: 	clearScroll(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Stops scrolling and drops anything waiting to scroll. Whatever is on the
+ * 			tubes stays there.
+ ************************************************************************************/
+void nixie::clearScroll(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	_scrollCount = 0;
+	_scrollTrail = 0;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	pushGlyph(uint8_t glyph)
+ *
+ * Params:	uint8_t glyph - the glyph to add
+ *
+ * Returns: Bool - false if the buffer is full.
+ *
+ * Desc:	Adds a glyph to the scroll buffer and starts scrolling if needed.
+ ************************************************************************************/
+bool nixie::pushGlyph(uint8_t glyph)
+{
+	if(_scrollCount >= SCROLL_BUFFER_SIZE) return false;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if(!_scrollTrail) //start from a blank window
+		memset((void *)_scrollWindow, SCROLL_BLANK, sizeof(_scrollWindow));
+	_scrollBuffer[(_scrollHead + _scrollCount) & (SCROLL_BUFFER_SIZE - 1)] = glyph;
+	_scrollCount++;
+	_scrollTrail = 6;
+	SREG = oldSREG;
+
+	/* start the shared tick */
+	nx = this;
+	TIMSK0 |= (1 << OCIE0A);
+
+	return true;
+}
+
+/*************************************************************************************
+ * Name: 	scrollStep(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Moves the scroll on by one tube and leaves the frame for update(). Called
+ * 			from the shared tick.
+ ************************************************************************************/
+void nixie::scrollStep(void)
+{
+	uint8_t next = SCROLL_BLANK;
+	if(_scrollCount)
+	{
+		next = _scrollBuffer[_scrollHead];
+		_scrollHead = (_scrollHead + 1) & (SCROLL_BUFFER_SIZE - 1);
+		_scrollCount--;
+	}
+	else
+		_scrollTrail--;
+
+	memmove((void *)_scrollWindow, (void *)(_scrollWindow + 1), 5);
+	_scrollWindow[5] = next;
+
+	/* build the frame */
+	uint8_t digits[6];
+	Frame_t frame;
+	frame.decimalPoints = 0;
+	for(uint8_t i = 0; i < 6; i++)
+	{
+		digits[i] = _scrollWindow[i] & ~SCROLL_DP;
+		if(_scrollWindow[i] & SCROLL_DP)
+			frame.decimalPoints |= (1 << pgm_read_byte(&_profile->decimalPoint[i]));
+	}
+	encode(digits, frame.tube);
+	postFrame(frame.tube, frame.decimalPoints);
 }
 
 /*************************************************************************************
@@ -494,8 +1037,9 @@ void nixie::display(float num)
 void nixie::setDecimalPoint(int segment, bool state)
 {
 	if(segment > 5) return;
-	if(state) _dpMask |= (1 << (7 - segment));
-	else _dpMask &= (0xFF ^ (1 << (7 - segment)));
+	uint8_t bit = pgm_read_byte(&_profile->decimalPoint[segment]);
+	if(state) _dpMask |= (1 << bit);
+	else _dpMask &= (0xFF ^ (1 << bit));
 }
 
 /*************************************************************************************
@@ -509,6 +1053,7 @@ void nixie::setDecimalPoint(int segment, bool state)
  ************************************************************************************/
 void nixie::blank(bool state) //blank function
 {
+	_lit = !state; //usage is only counted while lit
 	digitalWrite(_outputEnablePin, !state);
 }
 
@@ -526,20 +1071,49 @@ void nixie::setClockMode(bool state)
 	_clockModeEnable = state;	//sets the clock mode
 	for(uint8_t i = 0; i < 6; i++)
 		_symbolMask[i] = 0;
-	_dpMask = state ? 0x50 : 0x0; //sets the Decimal point mask to 001010000 - i.e. hh.mm.ss
+	_dpMask = 0x0;
+	setDecimalPoint(1, state); //i.e. hh.mm.ss
+	setDecimalPoint(3, state);
 }
 
 /*************************************************************************************
- * Name: 	setSegment(int segment, int symbolType)
+ * Name: 	setBoardProfile(const BoardProfile_t *profile)
  *
- * Params:	int segment - the segment we're setting
- * 			int symbolType - the tube type we're setting it to
+ * Params:	const BoardProfile_t *profile - the wiring of the board, in PROGMEM
  *
  * Returns: None.
  *
- * Desc:	Sets a segment to a specified tube type.
+ * Desc:	Sets how digits and decimal points map onto the driver outputs, for boards
+ * 			wired differently to the Doayee driver. For example:
+ *
+ * 			const nixie::BoardProfile_t myBoard PROGMEM = {
+ * 				CATHODE_MAP(0, 1, 2, 3, 4, 5, 6, 7, 8, 9),
+ * 				{ 5, 4, 3, 2, 1, 0 },
+ * 				{ 2, 3, 4, 5, 6, 7 }
+ * 			};
+ * 			nixie.setBoardProfile(&myBoard);
  ************************************************************************************/
-void nixie::setSegment(int segment, int symbolType)
+void nixie::setBoardProfile(const BoardProfile_t *profile)
+{
+	uint8_t dp = 0;
+	for(uint8_t i = 0; i < 6; i++) //carry the decimal points across
+		if(_dpMask & (1 << pgm_read_byte(&_profile->decimalPoint[i])))
+			dp |= (1 << pgm_read_byte(&profile->decimalPoint[i]));
+	_dpMask = dp;
+	_profile = profile;
+}
+
+/*************************************************************************************
+ * Name: 	setSegment(int segment, int symbolType)
+ *
+ * Params:	int segment - the segment we're setting
+ * 			int symbolType - the tube type we're setting it to
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets a segment to a specified tube type.
+ ************************************************************************************/
+void nixie::setSegment(int segment, int symbolType)
 {
 	if(segment > 5) return;
 	if(symbolType > 2) return;
@@ -568,6 +1142,276 @@ void nixie::setSymbol(int segment, int symbol)
 	_symbols[segment] = symbol;
 }
 
+/*************************************************************************************
+ * Name: 	displayEngineering(long value, int exponent, int unit)
+ *
+ * Params:	long value - the value to display, in units of 10^exponent
+ * 			int exponent - the power of ten of value, i.e. -3 if value is in mV
+ * 			int unit - the unit symbol, or BLANK for none
+ *
+ * Returns: Bool - false if the value can't fit on the tubes.
+ *
+ * Desc:	Displays a value in engineering notation using integer maths only. The
+ * 			unit goes on the right hand symbol tube of the right type, and the SI
+ * 			prefix (pico to mega) on the next IN-15A tube to its left. The prefix is
+ * 			picked so that there are 1 to 3 digits before the decimal point, and the
+ * 			rest of the number tubes are filled with digits, rounded to the last one.
+ * 			A negative value shows MINUS on the leftmost IN-15A tube not used for the
+ * 			unit or prefix, and without one the leftmost number tube is left blank
+ * 			instead, as for displaySigned().
+ *
+ * 			For example with tubes {0,0,0,0,IN15A,IN15B}, displayEngineering(4712, -3,
+ * 			VOLTS) shows 4.712 V and displayEngineering(150000, 0, HERTZ) 150.0 kHz.
+ ************************************************************************************/
+bool nixie::displayEngineering(long value, int exponent, int unit)
+{
+	uint32_t magnitude = (value < 0) ? -(uint32_t)value : value; //LONG_MIN has no long to negate to
+	if(magnitude == 0) exponent = 0;
+
+	/* find the unit tube, and the prefix tube to its left */
+	int8_t unitTube = -1;
+	int8_t prefixTube = -1;
+	uint8_t unitType = (unit < 10) ? IN15A : IN15B;
+	uint8_t numberTubes = 0;
+	for(int8_t i = 5; i >= 0; i--)
+	{
+		if(!_symbolMask[i]) numberTubes++;
+		else if(unitTube < 0 && unit < 20 && _symbolMask[i] == unitType) unitTube = i;
+		else if(prefixTube < 0 && _symbolMask[i] == IN15A) prefixTube = i;
+	}
+
+	/* a negative value's MINUS goes on a spare IN-15A, or a blank number tube */
+	int8_t signTube = -1;
+	bool signBlank = 0;
+	if(value < 0)
+	{
+		for(uint8_t i = 0; i < 6 && signTube < 0; i++)
+			if(_symbolMask[i] == IN15A && i != unitTube && i != prefixTube) signTube = i;
+		if(signTube < 0 && numberTubes)
+		{
+			signBlank = 1;
+			numberTubes--;
+		}
+	}
+	if(!numberTubes) return false;
+
+	/* pick the prefix, then round to the last digit shown and pick again in case it carried */
+	int8_t prefix, whole, lowest;
+	for(uint8_t pass = 0; pass < 2; pass++)
+	{
+		uint8_t length = 1;
+		while(length < 10 && magnitude >= pgm_read_dword(&powersOfTen[length])) length++;
+		int leading = exponent + length - 1; //power of ten of the first digit
+
+		int p = leading - ((leading % 3) + 3) % 3; //round down to a multiple of 3
+		if(prefixTube < 0) p = 0;
+		else if(p < -12) p = -12;
+		else if(p > 6) p = 6;
+		prefix = p;
+
+		whole = (leading - prefix + 1 > 0) ? leading - prefix + 1 : 1; //digits before the dp
+		lowest = prefix + whole - numberTubes; //power of ten of the last digit shown
+
+		if(pass || lowest <= exponent) break;
+		uint8_t k = lowest - exponent - 1;
+		if(k > 8) magnitude = 0; //too small to show, and adding 5*10^k would overflow
+		else magnitude += 5 * pgm_read_dword(&powersOfTen[k]);
+	}
+	if(whole > numberTubes) return false;
+
+	/* the symbols, for this value only - setSymbol()'s stay for the next one */
+	uint8_t symbols[6];
+	memcpy((void *)symbols, (void *)_symbols, 6);
+	if(prefixTube >= 0) symbols[prefixTube] = pgm_read_byte(&siPrefix[(prefix + 12) / 3]);
+	if(unitTube >= 0) symbols[unitTube] = unit;
+	if(signTube >= 0) symbols[signTube] = MINUS;
+
+	if(_clockModeEnable) _clockModeEnable = 0;
+	_dpMask = 0x0;
+
+	/* fill in the tubes */
+	uint8_t seg[6];
+	uint8_t digit = 0;
+	for(uint8_t i = 0; i < 6; i++)
+	{
+		if(_symbolMask[i])
+		{
+			if(_symbolMask[i] == IN15A && symbols[i] < 10) seg[i] = symbols[i];
+			else if(_symbolMask[i] == IN15B && (symbols[i] >= 10 && symbols[i] < 20)) seg[i] = symbols[i] - 10;
+			else seg[i] = BLANK;
+			continue;
+		}
+		if(signBlank)
+		{
+			seg[i] = BLANK;
+			signBlank = 0;
+			continue;
+		}
+
+		int power = prefix + whole - 1 - digit - exponent; //digit of magnitude to show
+		seg[i] = (power < 0 || power > 9) ? 0 : (magnitude / pgm_read_dword(&powersOfTen[power])) % 10;
+		if(++digit == whole && whole < numberTubes)
+			setDecimalPoint(i, 1);
+	}
+
+	displayDigits(seg);
+	return true;
+}
+
+/*************************************************************************************
+ * Name: 	displaySigned(long num)
+ *
+ * Params:	long num - number to display
+ *
+ * Returns: Bool - false if the number can't fit on the tubes.
+ *
+ * Desc:	Displays a number with its sign. The sign goes on the leftmost IN-15A tube
+ * 			as PLUS or MINUS (blank for zero), and without an IN-15A tube the leftmost
+ * 			number tube is left blank instead. Unlike display(long) nothing is
+ * 			dropped - a number with too many digits isn't shown.
+ ************************************************************************************/
+bool nixie::displaySigned(long num)
+{
+	uint32_t magnitude = (num < 0) ? -(uint32_t)num : num;
+	return displayNumber(magnitude, 10, (num < 0) ? MINUS : (num > 0) ? PLUS : BLANK);
+}
+
+/*************************************************************************************
+ * Name: 	displayHex(uint32_t num)
+ *
+ * Params:	uint32_t num - number to display
+ *
+ * Returns: Bool - false if the number can't fit on the tubes.
+ *
+ * Desc:	Displays a number in hexadecimal, see displayBase().
+ ************************************************************************************/
+bool nixie::displayHex(uint32_t num)
+{
+	return displayNumber(num, 16, NO_SIGN);
+}
+
+/*************************************************************************************
+ * Name: 	displayBase(uint32_t num, uint8_t base)
+ *
+ * Params:	uint32_t num - number to display
+ * 			uint8_t base - 2, 4, 8, 10 or 16
+ *
+ * Returns: Bool - false if the base isn't one of those, or the number can't fit on
+ * 			the tubes.
+ *
+ * Desc:	Displays a number in another base, with leading zeros across all of the
+ * 			number tubes. Symbol tubes show their symbols as for display(). A tube
+ * 			can't show the hex digits A to F, so they are shown as 0 to 5 with the
+ * 			tube's decimal point lit.
+ ************************************************************************************/
+bool nixie::displayBase(uint32_t num, uint8_t base)
+{
+	return displayNumber(num, base, NO_SIGN);
+}
+
+/*************************************************************************************
+ * Name: 	displayNumber(uint32_t magnitude, uint8_t base, uint8_t sign)
+ *
+ * Params:	uint32_t magnitude - number to display
+ * 			uint8_t base - 2, 4, 8, 10 or 16
+ * 			uint8_t sign - PLUS, MINUS or BLANK to show, or NO_SIGN
+ *
+ * Returns: Bool - false if the base isn't supported, or the number can't fit.
+ *
+ * Desc:	Works out the digits of a number without dividing - shifting them out for
+ * 			the powers of two, and for decimal taking away each power of ten from the
+ * 			table as many times as it goes - then shows them with the sign and any
+ * 			symbols. This is a private function used by the display functions above.
+ ************************************************************************************/
+bool nixie::displayNumber(uint32_t magnitude, uint8_t base, uint8_t sign)
+{
+	uint8_t shift;
+	switch(base)
+	{
+		case 2: shift = 1; break;
+		case 4: shift = 2; break;
+		case 8: shift = 3; break;
+		case 16: shift = 4; break;
+		case 10: shift = 0; break;
+		default: return false;
+	}
+
+	/* the tubes for digits, and the IN-15A for the sign */
+	int8_t signTube = -1;
+	uint8_t numberTubes = 0;
+	for(uint8_t i = 0; i < 6; i++)
+	{
+		if(!_symbolMask[i]) numberTubes++;
+		else if(signTube < 0 && _symbolMask[i] == IN15A) signTube = i;
+	}
+	bool signBlank = (sign != NO_SIGN && signTube < 0); //leave a number tube for it
+	if(signBlank) numberTubes--;
+	if(!numberTubes || numberTubes > 6) return false;
+
+	/* the digits, most significant first */
+	uint8_t digits[6];
+	if(shift)
+	{
+		for(int8_t d = numberTubes - 1; d >= 0; d--)
+		{
+			digits[d] = magnitude & (base - 1);
+			magnitude >>= shift;
+		}
+		if(magnitude) return false; //didn't fit
+	}
+	else
+	{
+		if(magnitude >= pgm_read_dword(&powersOfTen[numberTubes])) return false;
+		for(uint8_t d = 0; d < numberTubes; d++)
+		{
+			uint32_t power = pgm_read_dword(&powersOfTen[numberTubes - 1 - d]);
+			uint8_t digit = 0;
+			while(magnitude >= power)
+			{
+				magnitude -= power;
+				digit++;
+			}
+			digits[d] = digit;
+		}
+	}
+
+	if(_clockModeEnable) _clockModeEnable = 0;
+	_dpMask = 0x0;
+	uint8_t symbols[6]; //the sign is for this number only
+	memcpy((void *)symbols, (void *)_symbols, 6);
+	if(signTube >= 0 && sign != NO_SIGN) symbols[signTube] = sign;
+
+	/* fill in the tubes */
+	uint8_t seg[6];
+	uint8_t digit = 0;
+	for(uint8_t i = 0; i < 6; i++)
+	{
+		if(_symbolMask[i])
+		{
+			if(_symbolMask[i] == IN15A && symbols[i] < 10) seg[i] = symbols[i];
+			else if(_symbolMask[i] == IN15B && (symbols[i] >= 10 && symbols[i] < 20)) seg[i] = symbols[i] - 10;
+			else seg[i] = BLANK;
+		}
+		else if(signBlank)
+		{
+			seg[i] = BLANK;
+			signBlank = 0;
+		}
+		else
+		{
+			seg[i] = digits[digit++];
+			if(seg[i] > 9) //A to F
+			{
+				seg[i] -= 10;
+				setDecimalPoint(i, 1);
+			}
+		}
+	}
+
+	displayDigits(seg);
+	return true;
+}
+
 /*************************************************************************************
  * Name: 	setTime(int h, int m, int s)
  *
@@ -577,13 +1421,18 @@ void nixie::setSymbol(int segment, int symbol)
  *
  * Returns: None.
  *
- * Desc:	Sets the internal time variables.
+ * Desc:	Sets the internal time variables, and marks the time as synced.
  ************************************************************************************/
 void nixie::setTime(int h, int m, int s)
 {
+	uint8_t oldSREG = SREG;
+	cli();
 	hours = h;
 	minutes = m;
 	seconds = s;
+	_clockMs = 0; //the next second is a full second from now
+	_timeSynced = 1;
+	SREG = oldSREG;
 }
 
 /*************************************************************************************
@@ -625,6 +1474,7 @@ void nixie::setTime(char *strTime)
 void nixie::setHours(int h)
 {
 	hours = h;
+	_timeSynced = 1;
 }
 
 /*************************************************************************************
@@ -639,6 +1489,7 @@ void nixie::setHours(int h)
 void nixie::setMinutes(int m)
 {
 	minutes = m;
+	_timeSynced = 1;
 }
 
 /*************************************************************************************
@@ -653,6 +1504,7 @@ void nixie::setMinutes(int m)
 void nixie::setSeconds(int s)
 {
 	seconds = s;
+	_timeSynced = 1;
 }
 
 /*************************************************************************************
@@ -666,7 +1518,31 @@ void nixie::setSeconds(int s)
  ************************************************************************************/
 bool nixie::updateTime(void)
 {
+	bool shown = postTime();
+	showDue();
+	return shown;
+}
+
+/*************************************************************************************
+ * Name: 	postTime(void)
+ *
+ * Params:	None.
+ *
+ * Returns: Bool - as updateTime().
+ *
+ * Desc:	Builds the frame updateTime() shows and leaves it for update(), so the
+ * 			shared tick can move the time on without shifting it out itself.
+ ************************************************************************************/
+bool nixie::postTime(void)
+{
+	if (_editField)
+	{
+		showEdit();
+		return 1;
+	}
+
 	if (!_clockModeEnable) return 0;
+	if (_watchMode) return 1; //the stopwatch has the tubes
 
 	int a = (hours > 23 ? BLANK : (hours / 10));
 	int b = (hours > 23 ? BLANK : (hours % 10));
@@ -675,646 +1551,3895 @@ bool nixie::updateTime(void)
 	int e = (seconds > 59 ? BLANK : (seconds / 10));
 	int f = (seconds > 59 ? BLANK : (seconds % 10));
 
-	displayDigits(a, b, c, d, e, f);
+	uint8_t digits[6] = {(uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d, (uint8_t)e, (uint8_t)f};
+	uint16_t data[6];
+	encode(digits, data);
+	postFrame(data, _dpMask);
 
 	return 1;
 }
 
-/*-----------------------------------BACKLIGHT--------------------------------------*/
-
+/*************************************************************************************
+ *------------------------------ Timekeeping Overview -------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	With timekeeping on, the shared tick keeps the time itself rather than the sketch
+ *	counting millis(). Every 1000ms it moves the time on a second and, in clock
+ *	mode, builds the new time for update() to shift out.
+ *
+ *	Each second is also passed to the backlight. With setFadeSync() the fade steps
+ *	are then counted in seconds, minutes or hours of the clock instead of ms, and each
+ *	step ends on the tick that changes the digits. Both timers run from the same
+ *	clock, so the colours and the time can't drift apart however long it runs. See
+ *	the Fade Sync Overview for the backlight side.
+ *
+ ************************************************************************************/
 
 /*************************************************************************************
- * Name: 	backlight(uint8_t redPin, uint8_t greenPin, uint8_t bluePin)
+ * Name: 	setTimekeeping(bool state)
  *
- * Params:	uint8_t redPin - the analog pin for the red cathode
- * 			uint8_t greenPin - the analog pin for the green cathode
- * 			uint8_t bluePin - the analog pin for the blue cathode
+ * Params:	bool state - whether the shared tick keeps the time
  *
  * Returns: None.
  *
- * Desc:	Initialises the backlight object.
+ * Desc:	Turns timekeeping on or off. Set the time first with setTime().
  ************************************************************************************/
-backlight::backlight(int redPin, int greenPin, int bluePin)
+void nixie::setTimekeeping(bool state)
 {
-	_pins[0] = redPin;
-	_pins[1] = greenPin;
-	_pins[2] = bluePin;
-	for(uint8_t i = 0; i < 3; i++)
-		pinMode(_pins[i], 1);
-	setColour(black);
+	_timekeeping = state;
+
+	/* start the shared tick */
+	if(state)
+	{
+		nx = this;
+		TIMSK0 |= (1 << OCIE0A);
+	}
 }
 
 /*************************************************************************************
- * Name: 	setColour(uint8_t colour[])
+ * Name: 	secondTick(int h, int m, int s)
  *
- * Params:	uint8_t colour[] - array storing the colour to set
+ * Params:	int h - the hours
+ * 			int m - the minutes
+ * 			int s - the seconds
  *
  * Returns: None.
  *
- * Desc:	Sets the backlight to a specified colour.
+ * Desc:	For a time source outside the library, like rtc, to call once a second
+ * 			with the new time in place of the library's own timekeeping. Sets it,
+ * 			leaves it for update() to show in clock mode and passes the second on to
+ * 			the backlight. Safe to call from an interrupt.
  ************************************************************************************/
-void backlight::setColour(int colour[])
+void nixie::secondTick(int h, int m, int s)
 {
-	for(uint8_t i = 0; i < 3; i++) {
-		analogWrite(_pins[i], 255 - colour[i]);
-		currentColour[i] = colour[i];
-	}
+	if(h == hours && m == minutes && s == seconds) return; //already seen this second
+
+	uint8_t unit = (h != hours) ? SYNC_HOURS : (m != minutes) ? SYNC_MINUTES : SYNC_SECONDS;
+	setTime(h, m, s);
+	passSecond(unit);
+}
+
+/*************************************************************************************
+ * Name: 	isTimeSynced(void)
+ *
+ * Params:	None.
+ *
+ * Returns: Bool - whether the time has been set since power up.
+ *
+ * Desc:	Checks whether the time has come from the sketch, the time editor or an
+ * 			RTC. The time put back by restoreConfig() is only when it was saved, so
+ * 			it isn't synced until one of those sets it.
+ ************************************************************************************/
+bool nixie::isTimeSynced(void)
+{
+	return _timeSynced;
 }
 
 /*************************************************************************************
- * Name: 	crossFade(uint8_t startColour[], uint8_t endColour[], uint8_t duration)
+ * Name: 	passSecond(uint8_t unit)
  *
- * Params:	uint8_t startColour[] - array storing the colour to start on
- * 			uint8_t endColour[] - array storing the colour to end on
- * 			uint8_t duration - the duration of the fade
+ * Params:	uint8_t unit - the largest unit of the time that has just changed
  *
  * Returns: None.
  *
- * Desc:	Fades between two colours over a given time.
+ * Desc:	Leaves the new time for update() and lets the backlight know a second has
+ * 			gone.
  ************************************************************************************/
-void backlight::crossFade(int startColour[], int endColour[], int duration)
+void nixie::passSecond(uint8_t unit)
 {
-	int displayColour[3];
-	setColour(startColour); //start at the start colour
-	for (uint16_t i = 0; i < FADE_RESOLUTION; i++) { //for all the entries in the sine table
-		uint16_t wordFromProgMem = pgm_read_word_near(cosFade + i);
-		float sineFactor = (float)(wordFromProgMem) / 65535;
+	postTime();
+	if(bl != NULL) bl->clockTick(unit);
+}
 
-		for(uint8_t j = 0; j < 3; j++) { //for r, g, and b
-			displayColour[j] = startColour[j] + uint8_t(sineFactor * (endColour[j] - startColour[j]));
-			//fade along a sine wave (between -90 and +90) between the two colours
-		}
-		setColour(displayColour); 
-		delay(duration/FADE_RESOLUTION); //delay by the correct amount
-	}
-	setColour(endColour); //end colour to finish
+/*************************************************************************************
+ * Name: 	advanceClock(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint8_t - the largest unit that changed, SYNC_SECONDS, SYNC_MINUTES or
+ * 			SYNC_HOURS.
+ *
+ * Desc:	Moves the time on by a second.
+ ************************************************************************************/
+uint8_t nixie::advanceClock(void)
+{
+	if(++seconds < 60) return SYNC_SECONDS;
+	seconds = 0;
+
+	if(++minutes < 60) return SYNC_MINUTES;
+	minutes = 0;
+
+	if(++hours > 23) hours = 0;
+	return SYNC_HOURS;
 }
 
 /*************************************************************************************
- * Name: 	fadeIn(uint8_t colour[], uint8_t duration)
+ *----------------------------- Time Editing Overview -------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	Setting the time is a small state machine driven by the sketch, so nothing waits
+ *	for a button and the clock, fades and everything else carry on while it happens.
+ *
+ *	startTimeEdit() starts on the hours. Each call to editTime() then takes a key:
+ *
+ *		EDIT_UP / EDIT_DOWN - step the field being edited, wrapping round
+ *		EDIT_SELECT			- move on to the next field, hours -> minutes -> seconds,
+ *							  and after the seconds finish editing
+ *
+ *	The fields are changed in place, so with timekeeping on the clock keeps running
+ *	throughout, and changing the seconds starts the second again from there. While
+ *	editing, the shared tick flashes the field every EDIT_FLASH_MS by building a
+ *	frame with it blanked for update(), and updateTime() shows the same. A field is held on for a
+ *	full flash after each key so it can be seen changing.
+ *
+ *	For example, with a buttons set of up, select and down:
+ *
+ *		if(buttons.getEvent(&button, &event) && event != BUTTON_RELEASE)
+ *		{
+ *			if(nixie.getEditField() == FIELD_NONE)
+ *			{
+ *				if(button == 1 && event == BUTTON_PRESS) nixie.startTimeEdit();
+ *			}
+ *			else if(button == 1)
+ *			{
+ *				if(event == BUTTON_PRESS) nixie.editTime(EDIT_SELECT);
+ *			}
+ *			else if(event != BUTTON_LONG_PRESS)
+ *				nixie.editTime(button == 0 ? EDIT_UP : EDIT_DOWN);
+ *		}
+ *
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	startTimeEdit(void)
  *
- * Params:	uint8_t colour[] - array storing the colour to fade in to
- * 			uint8_t duration - the duration of the fade
+ * Params:	None.
  *
  * Returns: None.
  *
- * Desc:	Fades from black into a colour.
+ * Desc:	Starts editing the time, from the hours.
  ************************************************************************************/
-void backlight::fadeIn(int colour[], int duration)
+void nixie::startTimeEdit(void)
 {
-	int displayColour[3];
-	setColour(black); //start at black
-	for(uint8_t i = 4; i < (FADE_RESOLUTION/2 - 1); i++) //for the first half of the fade, increase linearly
+	_editBlink = 0;
+	_editTimer = EDIT_FLASH_MS;
+	_editField = FIELD_HOURS;
+	showEdit();
+	showDue();
+
+	/* start the shared tick */
+	nx = this;
+	TIMSK0 |= (1 << OCIE0A);
+}
+
+/*************************************************************************************
+ * Name: 	editTime(uint8_t key)
+ *
+ * Params:	uint8_t key - EDIT_UP, EDIT_DOWN or EDIT_SELECT
+ *
+ * Returns: Bool - whether the time is still being edited.
+ *
+ * Desc:	Passes a key press to the time editor.
+ ************************************************************************************/
+bool nixie::editTime(uint8_t key)
+{
+	if(!_editField) return 0;
+
+	if(key == EDIT_SELECT)
 	{
-		for(uint8_t j = 0; j < 3; j++)
-			displayColour[j] = uint8_t(float(i*0.5/(FADE_RESOLUTION/2 - 1)) * colour[j]);
-		setColour(displayColour);
-		delay(duration/(FADE_RESOLUTION-4));
+		if(_editField == FIELD_SECONDS)
+		{
+			_editField = FIELD_NONE;
+			_timeSynced = 1; //the user has set it
+			updateTime();
+			return 0;
+		}
+		_editField++;
 	}
-	for(uint16_t i = (FADE_RESOLUTION/2 - 1); i < FADE_RESOLUTION; i++) //for the second half of the fade, increase according to the sine
+	else if(key == EDIT_UP || key == EDIT_DOWN)
 	{
-		for(uint8_t j = 0; j < 3; j++)
+		int8_t step = (key == EDIT_UP) ? 1 : -1;
+
+		uint8_t oldSREG = SREG;
+		cli();
+		switch(_editField)
 		{
-			uint16_t wordFromProgMem = pgm_read_word_near(cosFade + i);
-			float sineFactor = (float)(wordFromProgMem) / 65535;
-			displayColour[j] = uint8_t(sineFactor * colour[j]);
+			case FIELD_HOURS:
+				hours = (hours + 24 + step) % 24;
+				break;
+			case FIELD_MINUTES:
+				minutes = (minutes + 60 + step) % 60;
+				break;
+			default:
+				seconds = (seconds + 60 + step) % 60;
+				_clockMs = 0;
+				break;
 		}
-		setColour(displayColour);
-		delay(duration/(FADE_RESOLUTION-4));
+		SREG = oldSREG;
 	}
-	setColour(colour);
+
+	/* hold the field on so the change can be seen */
+	_editBlink = 0;
+	_editTimer = EDIT_FLASH_MS;
+	showEdit();
+	showDue();
+	return 1;
 }
 
 /*************************************************************************************
- * Name: 	fadeOut(uint8_t duration)
+ * Name: 	getEditField(void)
  *
- * Params:	uint8_t duration - the duration of the fade
+ * Params:	None.
+ *
+ * Returns: uint8_t - FIELD_HOURS, FIELD_MINUTES, FIELD_SECONDS, or FIELD_NONE when
+ * 			not editing.
+ *
+ * Desc:	Gets the field being edited.
+ ************************************************************************************/
+uint8_t nixie::getEditField(void)
+{
+	return _editField;
+}
+
+/*************************************************************************************
+ * Name: 	showEdit(void)
+ *
+ * Params:	None.
  *
  * Returns: None.
  *
- * Desc:	Fades from the currentColour to black.
+ * Desc:	Builds the time with the field being edited flashed, and leaves it for
+ * 			update().
  ************************************************************************************/
-void backlight::fadeOut(int duration)
+void nixie::showEdit(void)
 {
-	uint8_t colour[3];
+	uint8_t time[3] = { hours, minutes, seconds };
+	uint8_t digits[6];
 	for(uint8_t i = 0; i < 3; i++)
-		colour[i] = currentColour[i];
-	int displayColour[3];
-	for(uint8_t i = FADE_RESOLUTION - 1; i > (FADE_RESOLUTION/2 - 1); i--) //for the first half of the fade, decrease according to the sine
-	{
-		for(uint8_t j = 0; j < 3; j++)
-		{
-			uint16_t wordFromProgMem = pgm_read_word_near(cosFade + i);
-			float sineFactor = (float)(wordFromProgMem) / 65535;
-			displayColour[j] = uint8_t(sineFactor * colour[j]);
-		}
-		setColour(displayColour);
-		delay(duration/(FADE_RESOLUTION-2));
-	}
-	for(uint8_t i = (FADE_RESOLUTION/2 - 1); i > 0; i--) //for the second half of the fade, decrease linearly
 	{
-		for(uint8_t j = 0; j < 3; j++)
-			displayColour[j] = uint8_t(float(i*0.5/(FADE_RESOLUTION/2 - 1)) * colour[j]);
-		setColour(displayColour);
-		delay(duration/(FADE_RESOLUTION-2));
+		bool off = _editBlink && (_editField == i + 1);
+		digits[2 * i] = off ? BLANK : time[i] / 10;
+		digits[2 * i + 1] = off ? BLANK : time[i] % 10;
 	}
-	setColour(black);
+
+	uint16_t data[6];
+	encode(digits, data);
+	postFrame(data, _dpMask);
 }
 
 /*************************************************************************************
- *--------------------------- Colour Fading Overview --------------------------------*
+ *------------------------------- Stopwatch Overview --------------------------------*
  *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
  *
- *	The background fading works by using TIMER1 to trigger a regular interrupt, which
- *	changes the colour. The timer will interrupt 256 timer per complete colour change,
- *	with a minimum (theoretical) colour change speed of 256us and a maximum of
- *	65535ms.
+ *	The stopwatch counts up from zero with startStopwatch(), or down to zero with
+ *	startCountdown(), in hundredths of a second on the shared tick. Under an hour it
+ *	shows mm.ss.hh, and from an hour hh.mm.ss, up to 99 hours.
  *
- *  For the setup of the colour fading, we use a 2d array provided by the user, this
- *  should adhere to the following format:
+ *	The time is kept as BCD digits, one per tube, so each hundredth is a single
+ *	digit step with a carry rather than dividing the time down again. Only the tubes
+ *	whose digits changed are looked up in the board profile, into a frame kept for
+ *	the stopwatch, and that frame is left for update() to shift out - usually one
+ *	lookup per hundredth.
  *
- *		{ Colour_1_Red, Colour_1_Green, Colour_1_Blue, Duration_1 },
- *		{ Colour_2_Red, Colour_2_Green, Colour_2_Blue, Duration_2 },
- *								  ...
- * 		{ Colour_N_Red, Colour_N_Green, Colour_N_Blue, Duration_N }
+ *	lapStopwatch() takes the time without stopping, up to STOPWATCH_LAPS times.
+ *	getSplit() gives the time at a lap and getLap() the time since the lap before (or
+ *	since the start), both in hundredths.
  *
- * 	Where 'Duration_(X)' refers to the duration of the fade from Colour_(X) to
- * 	Colour_(X+1).
+ *	When a countdown reaches zero it stops on 00.00.00 and the alarm callback is
+ *	called from update(), so it doesn't run in the interrupt:
  *
- * 	It takes this data and uses it to build a loop of CycleType_t's. These are a
- * 	custom type which each contain the colour, a duration, and a pointer to the
- * 	next CycleType_t in the loop. The final node in the loop points back to the
- * 	first node (hence making it a loop).
+ *		void ring(void) { rgb.crossFade(rgb.black, rgb.red, 100); }
  *
- * 	There are 2 global CycleType_t's, which are:
+ *		nixie.setAlarmCallback(ring);
+ *		nixie.startCountdown(0, 5, 0);
  *
- * 		CycleType_t *currentNode; - The node we are currently interacting with
- * 		CycleType_t *entryNode;   - A node populated with the current colour at the
- * 							        time of the fade being initialised, which points
- * 							        to the 'first' node of the loop.
+ *		void loop() { nixie.update(); }
  *
- * 	These serve as the basis for all interaction with the loop.
+ *	While the stopwatch runs it has the tubes to itself, timekeeping carries on in
+ *	the background and clock mode shows the time again after endStopwatch().
  *
- * 	There are also 2 other globals which are needed for the colour fading, there are:
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	startStopwatch(void)
  *
- *  	uint8_t[3] currentFadeColour - this holds the current colour of the fade.
- *  	uint32_t timerCount 		 - this is incremented on each isr call and is
- *  						  		   used for tracking when we need to swap from one
- *  						  		   colour to the next.
+ * Params:	None.
  *
- * 	The fading itself is done in the following manner:
- * 	1) The user calls setFade with the setup array.
- * 	2) The loop is set up and all the types are populated. - setFade()
- * 	3) The timer is set up with a prescaler determined by the duration of the first
- * 	   node of the cycle. It will run at the max speed it can without overflowing
- * 	   the timer - this increases the resolution of the timing and thus the overall
- * 	   accuracy. The timer is then preloaded with a value such that is overflows in
- * 	   the desired time. - timerSetup()
- * 	4) The interrupt is enabled.
- * 	5) On the interrupt, the timer resets the pre-loaded value to interrupt again in
- * 	   the desired time. It then fetches values from the node and the cos fade table
- * 	   which it uses to compute the colour change required. Once this change has been
- * 	   implemented it incrememnts the counter and checks to see if a node swap is
- * 	   needed, if not it returns. - isr()
- * 	6) If a swap is needed then the timer interrupt is disabled, the current node is
- * 	   swapped to the next node, and the timer values are recalculated and applied.
- * 	   - swapNode()
+ * Returns: None.
+ *
+ * Desc:	Starts the stopwatch counting up from zero.
+ ************************************************************************************/
+void nixie::startStopwatch(void)
+{
+	memset((void *)_watch, 0, sizeof(_watch));
+	startWatch(STOPWATCH_UP);
+}
+
+/*************************************************************************************
+ * Name: 	startCountdown(int h, int m, int s)
  *
+ * Params:	int h - the hours, up to 99
+ * 			int m - the minutes
+ * 			int s - the seconds
+ *
+ * Returns: None.
  *
+ * Desc:	Starts the stopwatch counting down to zero from the time given. Each
+ * 			part is kept between 0 and its limit.
  ************************************************************************************/
+void nixie::startCountdown(int h, int m, int s)
+{
+	int time[3] = { h, m, s };
+	const int limit[3] = { 99, 59, 59 };
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		if(time[i] < 0) time[i] = 0; //would give negative digits
+		if(time[i] > limit[i]) time[i] = limit[i];
+		_watch[2 * i] = time[i] / 10;
+		_watch[2 * i + 1] = time[i] % 10;
+	}
+	_watch[6] = 0;
+	_watch[7] = 0;
+	startWatch(STOPWATCH_DOWN);
+}
 
+/*************************************************************************************
+ * Name: 	startWatch(uint8_t mode)
+ *
+ * Params:	uint8_t mode - STOPWATCH_UP or STOPWATCH_DOWN
+ *
+ * Returns: None.
+ *
+ * Desc:	Starts the stopwatch from the digits already in _watch.
+ ************************************************************************************/
+void nixie::startWatch(uint8_t mode)
+{
+	_watchMode = STOPWATCH_OFF; //keep the tick off the digits while they're set up
+	_watchMs = 0;
+	_watchStart = packWatch();
+	_lapCount = 0;
+	_watchPaused = (mode == STOPWATCH_DOWN && !_watchStart); //a countdown from zero is already done
+	_alarmDue = _watchPaused;
+
+	_watchPoints = (1 << pgm_read_byte(&_profile->decimalPoint[1])) | //i.e. mm.ss.hh
+				   (1 << pgm_read_byte(&_profile->decimalPoint[3]));
+	_watchWindow = 0xFF;
+	showWatch(0);
+	showDue();
+
+	_watchMode = mode;
+
+	/* start the shared tick */
+	nx = this;
+	TIMSK0 |= (1 << OCIE0A);
+}
 
 /*************************************************************************************
- * Name: 	setFade(uint8_t setup[][4], uint8_t numberOfColours, uint8_t fadeInTime)
+ * Name: 	pauseStopwatch(bool state)
  *
- * Params:	uint8_t setup[][4] 		- the setup array for the fade
- * 			uint8_t numberOfColours - the number of colours in the fade
- * 			uint8_t fadeInTime		- the time taken to fade in to the fade
+ * Params:	bool state - 1 to pause, 0 to carry on
  *
- * Returns: Bool - success or failure (failure usually caused by not enough memory).
+ * Returns: None.
  *
- * Desc:	Starts a background colour fade.
+ * Desc:	Pauses the stopwatch, or carries on from where it was paused. The time
+ * 			stays on the tubes while paused.
  ************************************************************************************/
-bool backlight::setFade(int setup[][4], int fadeInTime)
+void nixie::pauseStopwatch(bool state)
 {
-	//get the memory for the first node
-	backlight::CycleType_t *root = (backlight::CycleType_t *)malloc(sizeof(backlight::CycleType_t));
+	if(_watchMode == STOPWATCH_DOWN && !state && !packWatch()) return; //nothing left to count
+	_watchPaused = state;
+}
 
-	//check we have enough
-	if(root == NULL) return false;
+/*************************************************************************************
+ * Name: 	endStopwatch(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Stops the stopwatch and gives the tubes back, to the time in clock mode.
+ ************************************************************************************/
+void nixie::endStopwatch(void)
+{
+	_watchMode = STOPWATCH_OFF;
+	_watchPaused = 0;
+	updateTime();
+}
 
-	/* Determine length of array */
-	uint8_t i = 0;
-	while(setup[i++][3] != 0)
-		if(i == 0) return false; //if it wraps
+/*************************************************************************************
+ * Name: 	getStopwatchMode(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint8_t - STOPWATCH_UP, STOPWATCH_DOWN, or STOPWATCH_OFF when not running.
+ *
+ * Desc:	Gets what the stopwatch is doing.
+ ************************************************************************************/
+uint8_t nixie::getStopwatchMode(void)
+{
+	return _watchMode;
+}
 
-	//if the array consists of only ENDCYCLE
-	if(i == 1) return false;
+/*************************************************************************************
+ * Name: 	getStopwatch(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint32_t - the time on the stopwatch in hundredths of a second.
+ *
+ * Desc:	Reads the stopwatch.
+ ************************************************************************************/
+uint32_t nixie::getStopwatch(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	uint32_t bcd = packWatch();
+	SREG = oldSREG;
 
-	//will hold the final pointer we need to wrap the loop
-	backlight::CycleType_t *loopNode = buildLoop(root, (uint16_t (*)[4])setup, 0, i-2);
+	return watchHundredths(bcd);
+}
 
-	/* make setup into a loop of cycletype_t */
-	if(NULL == loopNode)
+/*************************************************************************************
+ * Name: 	lapStopwatch(void)
+ *
+ * Params:	None.
+ *
+ * Returns: Bool - false if the stopwatch isn't running, or STOPWATCH_LAPS have been
+ * 			taken already.
+ *
+ * Desc:	Takes the time for a lap, without stopping the stopwatch.
+ ************************************************************************************/
+bool nixie::lapStopwatch(void)
+{
+	if(!_watchMode || _lapCount >= STOPWATCH_LAPS) return false;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	_laps[_lapCount++] = packWatch();
+	SREG = oldSREG;
+	return true;
+}
+
+/*************************************************************************************
+ * Name: 	lapsTaken(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint8_t - the number of laps taken since the stopwatch started.
+ *
+ * Desc:	Gets how many laps there are to read back.
+ ************************************************************************************/
+uint8_t nixie::lapsTaken(void)
+{
+	return _lapCount;
+}
+
+/*************************************************************************************
+ * Name: 	getSplit(uint8_t lap)
+ *
+ * Params:	uint8_t lap - the lap, from 0
+ *
+ * Returns: uint32_t - the time on the stopwatch at the lap in hundredths of a second,
+ * 			0 if the lap hasn't been taken.
+ *
+ * Desc:	Reads back a lap as the time shown when it was taken.
+ ************************************************************************************/
+uint32_t nixie::getSplit(uint8_t lap)
+{
+	if(lap >= _lapCount) return 0;
+	return watchHundredths(_laps[lap]);
+}
+
+/*************************************************************************************
+ * Name: 	getLap(uint8_t lap)
+ *
+ * Params:	uint8_t lap - the lap, from 0
+ *
+ * Returns: uint32_t - the length of the lap in hundredths of a second, 0 if the lap
+ * 			hasn't been taken.
+ *
+ * Desc:	Reads back a lap as the time since the lap before, or since the start.
+ ************************************************************************************/
+uint32_t nixie::getLap(uint8_t lap)
+{
+	if(lap >= _lapCount) return 0;
+
+	uint32_t from = watchHundredths(lap ? _laps[lap - 1] : _watchStart);
+	uint32_t to = watchHundredths(_laps[lap]);
+	return (from > to) ? from - to : to - from; //counting down or up
+}
+
+/*************************************************************************************
+ * Name: 	setAlarmCallback(AlarmCallback_t callback)
+ *
+ * Params:	AlarmCallback_t callback - function to call, or NULL for none
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets the function update() calls when a countdown reaches zero.
+ ************************************************************************************/
+void nixie::setAlarmCallback(AlarmCallback_t callback)
+{
+	_alarmCallback = callback;
+}
+
+/*************************************************************************************
+ * Name: 	update(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Shifts out the frame the shared tick has left, if there is one, moves any
+ * 			flush of the usage log along and calls the alarm callback if a countdown
+ * 			has reached zero since the last call. Call this from loop().
+ ************************************************************************************/
+void nixie::update(void)
+{
+	showDue();
+	if(_usage != NULL) usageFlushStep();
+
+	if(!_alarmDue) return;
+	_alarmDue = 0;
+	if(_alarmCallback != NULL) _alarmCallback();
+}
+
+/*************************************************************************************
+ * Name: 	stepWatch(void)
+ *
+ * Params:	None.
+ *
+ * Returns: int8_t - the first digit of _watch that changed.
+ *
+ * Desc:	Moves the stopwatch on a hundredth of a second, up or down. A countdown
+ * 			stops when it reaches zero and raises the alarm.
+ ************************************************************************************/
+int8_t nixie::stepWatch(void)
+{
+	int8_t i = 7;
+
+	if(_watchMode == STOPWATCH_UP)
 	{
-		free((void *)root);
-		return false;
+		while(++_watch[i] >= pgm_read_byte(&watchLimit[i]))
+		{
+			_watch[i] = 0; //carry, round to zero after 99 hours
+			if(--i < 0) return 0;
+		}
+		return i;
 	}
 
-	/* wrap the loop */
-	loopNode->next = root;
+	while(_watch[i] == 0)
+	{
+		_watch[i] = pgm_read_byte(&watchLimit[i]) - 1; //borrow
+		i--;
+	}
+	_watch[i]--;
 
-	/* Create entry node */
-	entry = (backlight::CycleType_t *)malloc(sizeof(backlight::CycleType_t));
-	if(entry == NULL)
+	/* reached zero */
+	if(_watch[i] == 0 && !packWatch())
 	{
-		freeLoop(root, loopNode);
-		return false;
+		_watchPaused = 1;
+		_alarmDue = 1;
 	}
+	return i;
+}
 
-	/* copy current colour to entry colour */
-	memcpy((void*)entry->colour, (void *)currentColour, 3);
+/*************************************************************************************
+ * Name: 	showWatch(int8_t from)
+ *
+ * Params:	int8_t from - the first digit of _watch that has changed
+ *
+ * Returns: None.
+ *
+ * Desc:	Updates the stopwatch frame from the digits that have changed and leaves
+ * 			it for update().
+ ************************************************************************************/
+void nixie::showWatch(int8_t from)
+{
+	/* hh.mm.ss from an hour, mm.ss.hh under */
+	uint8_t window = (_watch[0] || _watch[1]) ? 0 : 2;
+	if(window != _watchWindow)
+	{
+		_watchWindow = window;
+		from = 0;
+	}
 
-	entry->duration = fadeInTime;
-	entry->next = root;
+	int8_t tube = from - window;
+	if(tube < 0) tube = 0;
+	for(; tube < 6; tube++)
+	{
+		uint8_t position = pgm_read_byte(&_profile->tube[tube]);
+		_watchFrame[position] = pgm_read_word(&_profile->cathode[_watch[window + tube]]);
+	}
 
-	currentNode = entry;
+	if(from - window < 6) postFrame(_watchFrame, _watchPoints);
+}
 
-	/* reset the globals */
-	timerCount = 0;
+/*************************************************************************************
+ * Name: 	packWatch(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint32_t - the stopwatch digits packed as BCD, hours first.
+ *
+ * Desc:	Takes a copy of the stopwatch that fits in a long.
+ ************************************************************************************/
+uint32_t nixie::packWatch(void)
+{
+	uint32_t bcd = 0;
+	for(uint8_t i = 0; i < 8; i++)
+		bcd = (bcd << 4) | _watch[i];
+	return bcd;
+}
 
-	timerSetup();
+/*************************************************************************************
+ * Name: 	watchHundredths(uint32_t bcd)
+ *
+ * Params:	uint32_t bcd - stopwatch digits as packed by packWatch()
+ *
+ * Returns: uint32_t - the time in hundredths of a second.
+ *
+ * Desc:	Converts a packed stopwatch time for the sketch.
+ ************************************************************************************/
+uint32_t nixie::watchHundredths(uint32_t bcd)
+{
+	uint32_t time = 0;
+	for(int8_t i = 7; i >= 0; i--)
+	{
+		uint8_t limit = pgm_read_byte(&watchLimit[7 - i]);
+		time = time * limit + ((bcd >> (4 * i)) & 0x0F);
+	}
+	return time;
+}
 
-	load_timer1_count(TIM1Preload);
+/*************************************************************************************
+ *--------------------------- Saved Configuration Overview --------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	saveConfig() keeps how the display is set up in EEPROM, and restoreConfig() puts
+ *	it back, so a sketch can call restoreConfig() first thing in setup() and show the
+ *	right thing straight away rather than setting everything up again from black.
+ *	Reading it back takes well under a ms; the first frame then goes out as soon as
+ *	it is restored.
+ *
+ *	What is kept is the clock mode, timekeeping, the symbol tubes and their symbols,
+ *	the decimal points, the time when it was saved, the frame last shown, and the
+ *	backlight - either its colour or the fade it was running, or about to run if
+ *	setFade() has given it a new one, up to CONFIG_FADE_STEPS steps. Each step keeps
+ *	its curve if it is one of the EASE_ curves; a step on a curve of the sketch's own
+ *	comes back on EASE_COSINE, as the table itself isn't saved.
+ *
+ *	In clock mode the restored time is shown, otherwise the frame last shown goes
+ *	back out as it was - a number, a frame, or whatever else was on the tubes. The
+ *	restored time is behind by however long the power was off, so isTimeSynced()
+ *	is false until the sketch, the time editor or an RTC sets it.
+ *
+ *	It is kept in CONFIG_SLOTS copies from CONFIG_EEPROM_ADDRESS, each laid out as:
+ *
+ *		{ Sequence, ConfigType_t, CRC_Low, CRC_High }
+ *
+ *	Each save goes into the oldest copy with the next sequence number, and the CRC
+ *	(CRC-16 of everything before it) is written last. A copy that was being written
+ *	at power down fails its CRC and the one before is used instead. Unchanged bytes
+ *	aren't written again, so saving the same thing twice costs no wear. Saving
+ *	waits for the EEPROM, about 3.3ms for each byte that has changed.
+ *
+ ************************************************************************************/
 
+static_assert(CONFIG_EEPROM_ADDRESS >= USAGE_EEPROM_ADDRESS + USAGE_SLOTS * USAGE_SLOT_SIZE,
+			  "the saved configuration overlaps the usage log");
 
-	/* set pwm timers running */
-	for(uint8_t i = 0; i < 3; i++)
+/*************************************************************************************
+ * Name: 	saveConfig(backlight *rgb)
+ *
+ * Params:	backlight *rgb - the backlight to save too, or NULL
+ *
+ * Returns: Bool - false if the EEPROM isn't big enough.
+ *
+ * Desc:	Saves the display setup to EEPROM.
+ ************************************************************************************/
+bool nixie::saveConfig(backlight *rgb)
+{
+	if(CONFIG_EEPROM_ADDRESS + CONFIG_SLOTS * CONFIG_SLOT_SIZE > E2END + 1) return false;
+
+	ConfigType_t config;
+	memset((void *)&config, 0, sizeof(config));
+
+	config.flags = (_clockModeEnable ? CONFIG_CLOCK_MODE : 0) | (_timekeeping ? CONFIG_TIMEKEEPING : 0);
+	memcpy((void *)config.symbolMask, (void *)_symbolMask, 6);
+	memcpy((void *)config.symbols, (void *)_symbols, 6);
+	config.dpMask = _dpMask;
+	memcpy((void *)config.frame, (void *)_frame, sizeof(config.frame));
+	config.framePoints = _framePoints;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	config.time[0] = hours;
+	config.time[1] = minutes;
+	config.time[2] = seconds;
+	SREG = oldSREG;
+
+	if(rgb != NULL)
 	{
-		if (currentColour[i] == 0)
-			analogWrite(_pins[i], 254);
-		else if(currentColour[i] == 255)
-			analogWrite(_pins[i], 1);
+		for(uint8_t i = 0; i < 3; i++)
+			config.colour[i] = rgb->currentColour[i];
+		const uint16_t *curves[CONFIG_FADE_STEPS];
+		config.fadeSteps = rgb->getFade(config.fade, curves, CONFIG_FADE_STEPS);
+		if(config.fadeSteps) config.flags |= CONFIG_FADING;
+
+		/* by number, CURVE_COSINE for one that isn't built in */
+		for(uint8_t i = 0; i < config.fadeSteps; i++)
+			for(uint8_t j = 0; j < FADE_CURVES; j++)
+				if(curves[i] == (const uint16_t *)pgm_read_ptr(&fadeCurves[j]))
+					config.fadeCurves[i] = j;
 	}
-	
-	TIMSK1 |= (1 << TOIE1);
 
+	/* write over the oldest copy */
+	int8_t newest = newestConfig();
+	uint8_t slot = (newest < 0) ? 0 : (newest + 1) % CONFIG_SLOTS;
+	uint8_t seq = (newest < 0) ? 0 : eeprom_read_byte(configSlot(newest)) + 1;
+	uint8_t *base = configSlot(slot);
+
+	eeprom_update_byte(base, seq);
+	eeprom_update_block((const void *)&config, (void *)(base + 1), sizeof(config));
+
+	uint16_t crc = configCrc(slot);
+	eeprom_update_byte(base + 1 + sizeof(config), crc & 0xFF);
+	eeprom_update_byte(base + 2 + sizeof(config), crc >> 8);
 	return true;
+}
+
+/*************************************************************************************
+ * Name: 	restoreConfig(backlight *rgb)
+ *
+ * Params:	backlight *rgb - the backlight to restore too, or NULL
+ *
+ * Returns: Bool - false if nothing has been saved.
+ *
+ * Desc:	Puts back the display setup saved by saveConfig() and shows it - the time
+ * 			in clock mode, or the frame that was last shown otherwise. The time isn't
+ * 			synced until it is set again, see isTimeSynced().
+ ************************************************************************************/
+bool nixie::restoreConfig(backlight *rgb)
+{
+	int8_t newest = newestConfig();
+	if(newest < 0) return false;
+
+	ConfigType_t config;
+	eeprom_read_block((void *)&config, (const void *)(configSlot(newest) + 1), sizeof(config));
+
+	/* the tubes */
+	for(uint8_t i = 0; i < 6; i++)
+		setSegment(i, 0);
+	setClockMode(config.flags & CONFIG_CLOCK_MODE);
+	for(uint8_t i = 0; i < 6; i++)
+	{
+		setSegment(i, config.symbolMask[i]);
+		_symbols[i] = config.symbols[i];
+	}
+	_dpMask = config.dpMask;
+	setTime(config.time[0], config.time[1], config.time[2]);
+	_timeSynced = 0; //only the time it was saved, until the sketch or an RTC sets it
+	if(_clockModeEnable)
+		updateTime();
+	else
+		shift(config.frame, config.framePoints); //whatever was last shown
+
+	/* the backlight, straight to where it was rather than fading in */
+	if(rgb != NULL)
+	{
+		if(config.flags & CONFIG_FADING)
+		{
+			int setup[CONFIG_FADE_STEPS + 1][4];
+			memcpy((void *)setup, (void *)config.fade, sizeof(config.fade));
+			for(uint8_t j = 0; j < 4; j++)
+				setup[config.fadeSteps][j] = 0; //ENDCYCLE
+
+			const uint16_t *curves[CONFIG_FADE_STEPS];
+			for(uint8_t i = 0; i < config.fadeSteps; i++)
+			{
+				uint8_t curve = (config.fadeCurves[i] < FADE_CURVES) ? config.fadeCurves[i] : CURVE_COSINE;
+				curves[i] = (const uint16_t *)pgm_read_ptr(&fadeCurves[curve]);
+			}
+
+			int first[3] = { setup[0][0], setup[0][1], setup[0][2] };
+			if(!(first[0] & 0x100)) rgb->setColour(first);
+			rgb->setFade(setup, curves, 0);
+		}
+		else
+		{
+			int colour[3] = { config.colour[0], config.colour[1], config.colour[2] };
+			rgb->setColour(colour);
+		}
+	}
+
+	setTimekeeping(config.flags & CONFIG_TIMEKEEPING);
+	return true;
+}
+
+/*************************************************************************************
+ * Name: 	newestConfig(void)
+ *
+ * Params:	None.
+ *
+ * Returns: int8_t - the newest copy of the configuration with a good CRC, or -1 if
+ * 			there isn't one.
+ *
+ * Desc:	Finds the configuration to restore.
+ ************************************************************************************/
+int8_t nixie::newestConfig(void)
+{
+	if(CONFIG_EEPROM_ADDRESS + CONFIG_SLOTS * CONFIG_SLOT_SIZE > E2END + 1) return -1;
+
+	int8_t newest = -1;
+	uint8_t newestSeq = 0;
+	for(uint8_t i = 0; i < CONFIG_SLOTS; i++)
+	{
+		uint8_t *base = configSlot(i);
+		uint16_t crc = eeprom_read_byte(base + 1 + sizeof(ConfigType_t)) |
+					   (eeprom_read_byte(base + 2 + sizeof(ConfigType_t)) << 8);
+		if(crc != configCrc(i)) continue;
+
+		uint8_t seq = eeprom_read_byte(base);
+		if(newest < 0 || (int8_t)(seq - newestSeq) > 0)
+		{
+			newest = i;
+			newestSeq = seq;
+		}
+	}
+	return newest;
+}
+
+/*************************************************************************************
+ * Name: 	configSlot(uint8_t slot)
+ *
+ * Params:	uint8_t slot - the copy
+ *
+ * Returns: uint8_t * - the EEPROM address of the copy.
+ *
+ * Desc:	Finds a copy of the configuration.
+ ************************************************************************************/
+uint8_t *nixie::configSlot(uint8_t slot)
+{
+	return (uint8_t *)(CONFIG_EEPROM_ADDRESS + slot * CONFIG_SLOT_SIZE);
+}
+
+/*************************************************************************************
+ * Name: 	configCrc(uint8_t slot)
+ *
+ * Params:	uint8_t slot - the copy
+ *
+ * Returns: uint16_t - the CRC-16 of the sequence and configuration in the copy.
+ *
+ * Desc:	Works out the CRC a copy should have.
+ ************************************************************************************/
+uint16_t nixie::configCrc(uint8_t slot)
+{
+	uint8_t *base = configSlot(slot);
+	uint16_t crc = 0xFFFF;
+	for(uint8_t i = 0; i < 1 + sizeof(ConfigType_t); i++)
+		crc = _crc16_update(crc, eeprom_read_byte(base + i));
+	return crc;
+}
+
+/*************************************************************************************
+ *--------------------------- Cathode Usage Overview --------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	When enabled, the driver keeps a count of how long each cathode of each tube has
+ *	been lit. This is taken from the frame that shift() sends out, so it reflects
+ *	what the tubes actually showed rather than what was asked for.
+ *
+ *	The shared tick counts the ms each tube is lit with the last frame sent, and
+ *	every whole second is credited to its cathodes in _frame, so a display left
+ *	showing the same thing is counted as well. Seconds go into a saturating 16 bit
+ *	counter in RAM, and the ms towards the next second are carried per tube.
+ *
+ *	Every USAGE_FLUSH_INTERVAL the whole hours in RAM are added to the log in EEPROM,
+ *	which holds a saturating 16 bit count of hours per cathode (about 7 years). The
+ *	log is kept in USAGE_SLOTS copies, each laid out as:
+ *
+ *		{ Magic, Sequence, Tube_0_Cathode_0, ... Tube_5_Cathode_9 }
+ *
+ *	A flush writes the next slot round, so each copy only sees 1 in USAGE_SLOTS of
+ *	the writes. The magic byte is cleared first and written last, so a slot that was
+ *	being written at power down is ignored and the previous slot is used instead.
+ *	The flush is moved on by update() from loop(), one byte a call and only once
+ *	the EEPROM is ready, so nothing waits for a write to finish. It is never written
+ *	from an interrupt, so it can't land part way through a write of the sketch's
+ *	own, such as saveConfig().
+ *
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	setUsageTracking(bool state)
+ *
+ * Params:	bool state - whether to track cathode usage
+ *
+ * Returns: Bool - success or failure (failure caused by not enough memory).
+ *
+ * Desc:	Enables/disables counting of the time each cathode spends lit. The log is
+ * 			written to EEPROM by update(), so call that from loop(). When disabling,
+ * 			any unwritten hours are flushed to EEPROM first.
+ ************************************************************************************/
+bool nixie::setUsageTracking(bool state)
+{
+	if(!state)
+	{
+		if(_usage == NULL) return true;
+		flushUsage();
+
+		uint8_t oldSREG = SREG;
+		cli();
+		UsageType_t *usage = _usage; //the tick is done with it
+		_usage = NULL;
+		SREG = oldSREG;
+		free((void *)usage);
+		return true;
+	}
+
+	if(_usage != NULL) return true;
+
+	UsageType_t *usage = (UsageType_t *)malloc(sizeof(UsageType_t));
+	if(usage == NULL) return false;
+	memset((void *)usage, 0, sizeof(UsageType_t));
+
+	/* find the most recent complete log */
+	usage->slot = 0xFF;
+	for(uint8_t i = 0; i < USAGE_SLOTS; i++)
+	{
+		uint8_t *base = (uint8_t *)(USAGE_EEPROM_ADDRESS + i * USAGE_SLOT_SIZE);
+		if(eeprom_read_byte(base) != USAGE_MAGIC) continue;
+		uint8_t seq = eeprom_read_byte(base + 1);
+		if(usage->slot == 0xFF || (int8_t)(seq - usage->seq) > 0)
+		{
+			usage->slot = i;
+			usage->seq = seq;
+		}
+	}
+
+	usage->flushStep = USAGE_IDLE;
+	usage->lastFlush = millis();
+	_usage = usage;
+
+	/* start the shared tick */
+	nx = this;
+	TIMSK0 |= (1 << OCIE0A);
+
+	return true;
+}
+
+/*************************************************************************************
+ * Name: 	getUsage(int tube, int digit)
+ *
+ * Params:	int tube - the tube, indexed at 0
+ * 			int digit - the digit (or symbol position) on that tube
+ *
+ * Returns: uint32_t - seconds the cathode has been lit, 0 if tracking is disabled.
+ *
+ * Desc:	Reads the total lit time of a cathode, including time not yet flushed.
+ ************************************************************************************/
+uint32_t nixie::getUsage(int tube, int digit)
+{
+	if(_usage == NULL || tube < 0 || tube > 5 || digit < 0 || digit > 9) return 0;
+
+	/* counters are kept by chain position and output, as shifted out */
+	uint8_t position = pgm_read_byte(&_profile->tube[tube]);
+	uint16_t bits = pgm_read_word(&_profile->cathode[digit]);
+	uint8_t index = 0;
+	while(index < 9 && !(bits & (1 << index))) index++;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	uint32_t total = _usage->seconds[position][index];
+	SREG = oldSREG;
+	if(_usage->slot != 0xFF)
+		total += (uint32_t)eeprom_read_word(usageSlotWord(_usage->slot, position * 10 + index)) * 3600;
+	return total;
+}
+
+/*************************************************************************************
+ * Name: 	flushUsage(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Writes any whole hours of usage to EEPROM now, blocking until done.
+ ************************************************************************************/
+void nixie::flushUsage(void)
+{
+	if(_usage == NULL) return;
+	if(_usage->flushStep == USAGE_IDLE)
+		_usage->lastFlush = millis() - USAGE_FLUSH_INTERVAL; //start one now
+	do usageFlushStep();
+	while(_usage->flushStep != USAGE_IDLE);
+}
+
+/*************************************************************************************
+ * Name: 	accountUsage(uint8_t elapsed)
+ *
+ * Params:	uint8_t elapsed - ms since the last tick
+ *
+ * Returns: None.
+ *
+ * Desc:	Called from the shared tick. Adds the time to each lit tube, and credits
+ * 			every whole second to the cathodes lit on it.
+ ************************************************************************************/
+void nixie::accountUsage(uint8_t elapsed)
+{
+	if(!_lit) return;
+
+	for(uint8_t i = 0; i < 6; i++)
+	{
+		if(!_frame[i]) continue; //tube is dark
+
+		_usage->residual[i] += elapsed;
+		if(_usage->residual[i] < 1000) continue;
+		_usage->residual[i] -= 1000;
+
+		for(uint8_t j = 0; j < 10; j++)
+			if((_frame[i] & (1 << j)) && _usage->seconds[i][j] < 0xFFFF) //saturate
+				_usage->seconds[i][j]++;
+	}
+}
+
+/*************************************************************************************
+ * Name: 	usageFlushStep(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Writes the next byte of a flush to EEPROM, starting a flush if one is due.
+ * 			Does nothing if the EEPROM is still busy with the last byte. Never called
+ * 			from an interrupt, and the counters are only touched with interrupts off
+ * 			as the shared tick adds to them.
+ ************************************************************************************/
+void nixie::usageFlushStep(void)
+{
+	uint8_t target = (_usage->slot == 0xFF) ? 0 : (_usage->slot + 1) % USAGE_SLOTS;
+	uint8_t *base = (uint8_t *)(USAGE_EEPROM_ADDRESS + target * USAGE_SLOT_SIZE);
+
+	if(_usage->flushStep == USAGE_IDLE)
+	{
+		if(millis() - _usage->lastFlush < USAGE_FLUSH_INTERVAL) return;
+		_usage->lastFlush = millis();
+
+		/* don't wear the EEPROM if there are no whole hours to add */
+		uint8_t oldSREG = SREG;
+		cli();
+		uint8_t i = 0;
+		while(i < 60 && _usage->seconds[i / 10][i % 10] < 3600) i++;
+		SREG = oldSREG;
+		if(i == 60) return;
+
+		_usage->flushStep = 0;
+	}
+
+	if(!eeprom_is_ready()) return;
+
+	uint8_t step = _usage->flushStep;
+	if(step == 0) //invalidate the slot while it's half written
+	{
+		eeprom_update_byte(base, 0);
+	}
+	else if(step <= 120) //counters, low byte then high byte
+	{
+		uint8_t index = (step - 1) >> 1;
+		if(step & 1)
+		{
+			uint8_t oldSREG = SREG;
+			cli();
+			uint32_t hours = _usage->seconds[index / 10][index % 10] / 3600;
+			SREG = oldSREG;
+			if(_usage->slot != 0xFF)
+				hours += eeprom_read_word(usageSlotWord(_usage->slot, index));
+			_usage->flushWord = (hours > 0xFFFF) ? 0xFFFF : hours;
+			eeprom_update_byte((uint8_t *)usageSlotWord(target, index), _usage->flushWord & 0xFF);
+		}
+		else
+			eeprom_update_byte((uint8_t *)usageSlotWord(target, index) + 1, _usage->flushWord >> 8);
+	}
+	else if(step == 121)
+	{
+		eeprom_update_byte(base + 1, _usage->seq + 1);
+	}
+	else //commit - remove what was written from RAM
+	{
+		eeprom_update_byte(base, USAGE_MAGIC);
+		for(uint8_t i = 0; i < 60; i++)
+		{
+			uint16_t written = eeprom_read_word(usageSlotWord(target, i));
+			if(_usage->slot != 0xFF)
+				written -= eeprom_read_word(usageSlotWord(_usage->slot, i));
+
+			uint8_t oldSREG = SREG;
+			cli();
+			_usage->seconds[i / 10][i % 10] -= (uint32_t)written * 3600;
+			SREG = oldSREG;
+		}
+		_usage->slot = target;
+		_usage->seq++;
+		_usage->flushStep = USAGE_IDLE;
+		return;
+	}
+	_usage->flushStep++;
+}
+
+/*************************************************************************************
+ * Name: 	usageSlotWord(uint8_t slot, uint8_t index)
+ *
+ * Params:	uint8_t slot - the slot of the usage log
+ * 			uint8_t index - the counter, tube * 10 + cathode
+ *
+ * Returns: uint16_t * - the EEPROM address of the counter.
+ *
+ * Desc:	Works out where a counter lives in EEPROM.
+ ************************************************************************************/
+uint16_t *nixie::usageSlotWord(uint8_t slot, uint8_t index)
+{
+	return (uint16_t *)(USAGE_EEPROM_ADDRESS + slot * USAGE_SLOT_SIZE + 2 + index * sizeof(uint16_t));
+}
+
+/*-----------------------------------BACKLIGHT--------------------------------------*/
+
+
+/*************************************************************************************
+ * Name: 	backlight(uint8_t redPin, uint8_t greenPin, uint8_t bluePin)
+ *
+ * Params:	uint8_t redPin - the analog pin for the red cathode
+ * 			uint8_t greenPin - the analog pin for the green cathode
+ * 			uint8_t bluePin - the analog pin for the blue cathode
+ *
+ * Returns: None.
+ *
+ * Desc:	Initialises the backlight object.
+ ************************************************************************************/
+backlight::backlight(int redPin, int greenPin, int bluePin)
+{
+	_pins[0] = redPin;
+	_pins[1] = greenPin;
+	_pins[2] = bluePin;
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		pinMode(_pins[i], 1);
+		_ocr8[i] = pwmRegister(_pins[i]); //so the ISR can write the duty straight in
+		_ocr16[i] = pwmRegister16(_pins[i]);
+	}
+	selectOutput();
+	bl = this;
+	fade_trace_setup();
+	setColour(black);
+}
+
+/*************************************************************************************
+ * Name: 	Colour_t(const int colour[])
+ *
+ * Params:	const int colour[] - array storing the colour, r,g,b or HSV()
+ *
+ * Returns: None.
+ *
+ * Desc:	Takes a colour from an array in RAM.
+ ************************************************************************************/
+backlight::Colour_t::Colour_t(const int colour[])
+{
+	for(uint8_t i = 0; i < 3; i++)
+		_colour[i] = colour[i];
+}
+
+/*************************************************************************************
+ * Name: 	Colour_t(const NamedColour_t &colour)
+ *
+ * Params:	const NamedColour_t &colour - the colour, in PROGMEM
+ *
+ * Returns: None.
+ *
+ * Desc:	Takes a colour from PROGMEM, such as backlight::white.
+ ************************************************************************************/
+backlight::Colour_t::Colour_t(const NamedColour_t &colour)
+{
+	for(uint8_t i = 0; i < 3; i++)
+		_colour[i] = pgm_read_byte(&colour.rgb[i]);
+}
+
+/*************************************************************************************
+ * Name: 	operator[](uint8_t i)
+ *
+ * Params:	uint8_t i - the channel, 0 -> 2 for r,g,b
+ *
+ * Returns: int - the value of the channel.
+ *
+ * Desc:	Reads a colour as if it were the array it came from.
+ ************************************************************************************/
+int backlight::Colour_t::operator[](uint8_t i) const
+{
+	return _colour[i];
+}
+
+/*************************************************************************************
+ * Name: 	getColour(const NamedColour_t &colour)
+ *
+ * Params:	const NamedColour_t &colour - the colour, in PROGMEM
+ *
+ * Returns: Colour_t - the colour, which can be read like an array.
+ *
+ * Desc:	Reads a named colour out of PROGMEM, i.e. rgb.getColour(rgb.red)[0] for
+ * 			what used to be rgb.red[0].
+ ************************************************************************************/
+backlight::Colour_t backlight::getColour(const NamedColour_t &colour)
+{
+	return Colour_t(colour);
+}
+
+/*************************************************************************************
+ * Name: 	setColour(const Colour_t &colour)
+ *
+ * Params:	const Colour_t &colour - the colour to set
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets the backlight to a specified colour.
+ ************************************************************************************/
+void backlight::setColour(const Colour_t &colour)
+{
+	for(uint8_t i = 0; i < 3; i++) {
+		if(_outputMode == PWM_HIGHRES && _ocr16[i] != NULL) outputHighRes(i, colour[i] << 8);
+		else analogWrite(_pins[i], 255 - calibrate(i, colour[i]));
+		currentColour[i] = colour[i];
+	}
+}
+
+/*************************************************************************************
+ * Name: 	setCalibration(const Calibration_t *profile)
+ *
+ * Params:	const Calibration_t *profile - the output table for each LED, in PROGMEM,
+ * 										   or NULL to remove any calibration
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets the tables every colour goes through on its way out to the LEDs, so
+ * 			that fades look even and the LEDs can be balanced. GAMMA() builds a table
+ * 			at compile time, for example:
+ *
+ * 			const backlight::Calibration_t myLeds PROGMEM = {
+ * 				{ GAMMA(22, 255), GAMMA(22, 160), GAMMA(22, 220) }
+ * 			};
+ * 			rgb.setCalibration(&myLeds);
+ *
+ * 			The current colour is redrawn through the new tables.
+ ************************************************************************************/
+void backlight::setCalibration(const Calibration_t *profile)
+{
+	for(uint8_t i = 0; i < 3; i++)
+		_calibration[i] = (profile == NULL) ? NULL : (const uint8_t *)pgm_read_ptr(&profile->channel[i]);
+
+	int colour[3] = { currentColour[0], currentColour[1], currentColour[2] };
+	if(!fade_running()) setColour(colour); //a running fade picks it up on the next tick
+}
+
+/*************************************************************************************
+ * Name: 	setOutputMode(uint8_t mode)
+ *
+ * Params:	uint8_t mode - PWM_8BIT or PWM_HIGHRES
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets how colours are output. PWM_8BIT is plain analogWrite resolution.
+ *
+ * 			PWM_HIGHRES keeps the fraction from the fade maths. Pins on a 16 bit timer
+ * 			other than TIMER1 (which runs the fades) have that timer switched to 16 bit
+ * 			fast PWM at about 244Hz. Other pins stay 8 bit, but on each fade tick the
+ * 			part of the colour the duty can't show is carried on to the next tick, so
+ * 			the average brightness has the extra resolution.
+ ************************************************************************************/
+void backlight::setOutputMode(uint8_t mode)
+{
+	_outputMode = mode;
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		if(_ocr16[i] != NULL) setHighRes(_pins[i], mode == PWM_HIGHRES);
+		_dither[i] = 0;
+	}
+	selectOutput();
+
+	int colour[3] = { currentColour[0], currentColour[1], currentColour[2] };
+	if(!fade_running()) setColour(colour); //a running fade picks it up on the next tick
+}
+
+/*************************************************************************************
+ * Name: 	selectOutput(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Picks the output routine for each LED from the output mode and the timer
+ * 			its pin is on, so the ISR calls straight through _output[] every tick
+ * 			without checking either.
+ ************************************************************************************/
+void backlight::selectOutput(void)
+{
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		if(_outputMode == PWM_8BIT)
+			_output[i] = (_ocr16[i] != NULL) ? outputWide : outputByte;
+		else
+			_output[i] = (_ocr16[i] != NULL) ? outputHighRes : outputDither;
+	}
+}
+
+/*************************************************************************************
+ * Name: 	outputByte(uint8_t channel, uint16_t level)
+ *
+ * Params:	uint8_t channel - the LED, 0 -> 2 for r,g,b
+ * 			uint16_t level - the brightness, 8.8 fixed point
+ *
+ * Returns: None.
+ *
+ * Desc:	Output routine for PWM_8BIT on an 8 bit timer.
+ ************************************************************************************/
+void backlight::outputByte(uint8_t channel, uint16_t level)
+{
+	*_ocr8[channel] = 255 - calibrate(channel, level >> 8);
+}
+
+/*************************************************************************************
+ * Name: 	outputWide(uint8_t channel, uint16_t level)
+ *
+ * Params:	uint8_t channel - the LED, 0 -> 2 for r,g,b
+ * 			uint16_t level - the brightness, 8.8 fixed point
+ *
+ * Returns: None.
+ *
+ * Desc:	Output routine for PWM_8BIT on a 16 bit timer running 8 bit PWM.
+ ************************************************************************************/
+void backlight::outputWide(uint8_t channel, uint16_t level)
+{
+	*_ocr16[channel] = 255 - calibrate(channel, level >> 8);
+}
+
+/*************************************************************************************
+ * Name: 	outputHighRes(uint8_t channel, uint16_t level)
+ *
+ * Params:	uint8_t channel - the LED, 0 -> 2 for r,g,b
+ * 			uint16_t level - the brightness, 8.8 fixed point
+ *
+ * Returns: None.
+ *
+ * Desc:	Output routine for PWM_HIGHRES on a 16 bit timer.
+ ************************************************************************************/
+void backlight::outputHighRes(uint8_t channel, uint16_t level)
+{
+	level = calibrate16(channel, level);
+	*_ocr16[channel] = 0xFFFF - (level + (level >> 8)); //stretch 0 -> 0xFF00 over all 16 bits
+}
+
+/*************************************************************************************
+ * Name: 	outputDither(uint8_t channel, uint16_t level)
+ *
+ * Params:	uint8_t channel - the LED, 0 -> 2 for r,g,b
+ * 			uint16_t level - the brightness, 8.8 fixed point
+ *
+ * Returns: None.
+ *
+ * Desc:	Output routine for PWM_HIGHRES on an 8 bit timer, a first order
+ * 			sigma-delta carrying the fraction to the next tick.
+ ************************************************************************************/
+void backlight::outputDither(uint8_t channel, uint16_t level)
+{
+	uint16_t sum = calibrate16(channel, level) + _dither[channel];
+	_dither[channel] = sum & 0xFF;
+	*_ocr8[channel] = 255 - (sum >> 8);
+}
+
+/*************************************************************************************
+ * Name: 	calibrate16(uint8_t channel, uint16_t level)
+ *
+ * Params:	uint8_t channel - the LED, 0 -> 2 for r,g,b
+ * 			uint16_t level - the brightness, 8.8 fixed point
+ *
+ * Returns: uint16_t - the calibrated brightness, 8.8 fixed point.
+ *
+ * Desc:	Passes a brightness through the calibration table for its LED, reading
+ * 			between the entries either side so the fraction isn't lost.
+ ************************************************************************************/
+uint16_t backlight::calibrate16(uint8_t channel, uint16_t level)
+{
+	if(_calibration[channel] == NULL) return level;
+
+	uint8_t index = level >> 8;
+	uint8_t low = pgm_read_byte(_calibration[channel] + index);
+	uint8_t high = (index == 255) ? low : pgm_read_byte(_calibration[channel] + index + 1);
+	return (low << 8) + (((int32_t)(high - low) * (level & 0xFF)));
+}
+
+/*************************************************************************************
+ * Name: 	setHighRes(uint8_t pin, bool enable)
+ *
+ * Params:	uint8_t pin - the pin
+ * 			bool enable - true to put the pin's timer into 16 bit mode, false to put
+ * 						  it back how the Arduino core set it up
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets up 16 bit PWM on pins that can have it.
+ ************************************************************************************/
+#define highres_case(n, ch)													\
+		case TIMER##n##ch:													\
+			setTimerResolution(&TCCR##n##A, &TCCR##n##B, &ICR##n, enable);	\
+			if(enable) TCCR##n##A |= (1 << COM##n##ch##1);					\
+			break
+
+void backlight::setHighRes(uint8_t pin, bool enable)
+{
+	switch(digitalPinToTimer(pin))
+	{
+		#if defined(ICR3) && defined(COM3A1)
+		highres_case(3, A);
+		#endif
+
+		#if defined(ICR3) && defined(COM3B1)
+		highres_case(3, B);
+		#endif
+
+		#if defined(ICR3) && defined(COM3C1)
+		highres_case(3, C);
+		#endif
+
+		#if defined(ICR4) && defined(COM4A1)
+		highres_case(4, A);
+		#endif
+
+		#if defined(ICR4) && defined(COM4B1)
+		highres_case(4, B);
+		#endif
+
+		#if defined(ICR4) && defined(COM4C1)
+		highres_case(4, C);
+		#endif
+
+		#if defined(ICR5) && defined(COM5A1)
+		highres_case(5, A);
+		#endif
+
+		#if defined(ICR5) && defined(COM5B1)
+		highres_case(5, B);
+		#endif
+
+		#if defined(ICR5) && defined(COM5C1)
+		highres_case(5, C);
+		#endif
+
+		default:
+			break;
+	}
+}
+
+/*************************************************************************************
+ * Name: 	setTimerResolution(volatile uint8_t *tccrA, volatile uint8_t *tccrB,
+ * 							   volatile uint16_t *icr, bool high)
+ *
+ * Params:	volatile uint8_t *tccrA, *tccrB - the timer's control registers
+ * 			volatile uint16_t *icr - the timer's input capture register
+ * 			bool high - true for 16 bit fast PWM, false for the Arduino default
+ *
+ * Returns: None.
+ *
+ * Desc:	Switches a 16 bit timer between 16 bit fast PWM with TOP = ICR and no
+ * 			prescaler (mode 14), and 8 bit phase correct PWM with a prescaler of 64
+ * 			(mode 1). The WGM and CS bits are in the same place on timers 3, 4 and 5.
+ ************************************************************************************/
+void backlight::setTimerResolution(volatile uint8_t *tccrA, volatile uint8_t *tccrB, volatile uint16_t *icr, bool high)
+{
+	if(high)
+	{
+		*icr = 0xFFFF;
+		*tccrA = (*tccrA & 0xFC) | (1 << 1);
+		*tccrB = (*tccrB & 0xE0) | (1 << 4) | (1 << 3) | (1 << 0);
+	}
+	else
+	{
+		*tccrA = (*tccrA & 0xFC) | (1 << 0);
+		*tccrB = (*tccrB & 0xE0) | (1 << 1) | (1 << 0);
+	}
+}
+
+/*************************************************************************************
+ * Name: 	calibrate(uint8_t channel, uint8_t val)
+ *
+ * Params:	uint8_t channel - the LED, 0 -> 2 for r,g,b
+ * 			uint8_t val - the colour value
+ *
+ * Returns: uint8_t - the value to output.
+ *
+ * Desc:	Passes a colour through the calibration table for its LED.
+ ************************************************************************************/
+uint8_t backlight::calibrate(uint8_t channel, uint8_t val)
+{
+	if(_calibration[channel] == NULL) return val;
+	return pgm_read_byte(_calibration[channel] + val);
+}
+
+/*************************************************************************************
+ * Name: 	crossFade(const Colour_t &startColour, const Colour_t &endColour, int duration)
+ *
+ * Params:	const Colour_t &startColour - the colour to start on
+ * 			const Colour_t &endColour - the colour to end on
+ * 			int duration - the duration of the fade
+ *
+ * Returns: None.
+ *
+ * Desc:	Fades between two colours over a given time.
+ ************************************************************************************/
+void backlight::crossFade(const Colour_t &startColour, const Colour_t &endColour, int duration)
+{
+	int displayColour[3];
+	setColour(startColour); //start at the start colour
+	for (uint16_t i = 0; i < FADE_RESOLUTION; i++) { //for all the entries in the sine table
+		uint16_t wordFromProgMem = pgm_read_word_near(cosFade + i);
+
+		for(uint8_t j = 0; j < 3; j++) { //for r, g, and b
+			int32_t difference = endColour[j] - startColour[j];
+			displayColour[j] = startColour[j] + (int)((difference * wordFromProgMem + 0x8000) >> 16);
+			//fade along a sine wave (between -90 and +90) between the two colours
+		}
+		setColour(displayColour); 
+		delay(duration/FADE_RESOLUTION); //delay by the correct amount
+	}
+	setColour(endColour); //end colour to finish
+	postEvent(ON_FADE_DONE, 0);
+}
+
+/*************************************************************************************
+ * Name: 	fadeIn(const Colour_t &colour, int duration)
+ *
+ * Params:	const Colour_t &colour - the colour to fade in to
+ * 			int duration - the duration of the fade
+ *
+ * Returns: None.
+ *
+ * Desc:	Fades from black into a colour.
+ ************************************************************************************/
+void backlight::fadeIn(const Colour_t &colour, int duration)
+{
+	int displayColour[3];
+	setColour(black); //start at black
+	for(uint16_t i = 4; i < (FADE_RESOLUTION/2 - 1); i++) //for the first half of the fade, increase linearly
+	{
+		for(uint8_t j = 0; j < 3; j++)
+			displayColour[j] = (uint8_t)((uint32_t)i * colour[j] / (FADE_RESOLUTION - 2));
+		setColour(displayColour);
+		delay(duration/(FADE_RESOLUTION-4));
+	}
+	for(uint16_t i = (FADE_RESOLUTION/2 - 1); i < FADE_RESOLUTION; i++) //for the second half of the fade, increase according to the sine
+	{
+		for(uint8_t j = 0; j < 3; j++)
+		{
+			uint16_t wordFromProgMem = pgm_read_word_near(cosFade + i);
+			displayColour[j] = (uint8_t)(((uint32_t)wordFromProgMem * colour[j] + 0x8000) >> 16);
+		}
+		setColour(displayColour);
+		delay(duration/(FADE_RESOLUTION-4));
+	}
+	setColour(colour);
+	postEvent(ON_FADE_DONE, 0);
+}
+
+/*************************************************************************************
+ * Name: 	fadeOut(uint8_t duration)
+ *
+ * Params:	uint8_t duration - the duration of the fade
+ *
+ * Returns: None.
+ *
+ * Desc:	Fades from the currentColour to black.
+ ************************************************************************************/
+void backlight::fadeOut(int duration)
+{
+	uint8_t colour[3];
+	for(uint8_t i = 0; i < 3; i++)
+		colour[i] = currentColour[i];
+	int displayColour[3];
+	for(uint16_t i = FADE_RESOLUTION - 1; i > (FADE_RESOLUTION/2 - 1); i--) //for the first half of the fade, decrease according to the sine
+	{
+		for(uint8_t j = 0; j < 3; j++)
+		{
+			uint16_t wordFromProgMem = pgm_read_word_near(cosFade + i);
+			displayColour[j] = (uint8_t)(((uint32_t)wordFromProgMem * colour[j] + 0x8000) >> 16);
+		}
+		setColour(displayColour);
+		delay(duration/(FADE_RESOLUTION-2));
+	}
+	for(uint16_t i = (FADE_RESOLUTION/2 - 1); i > 0; i--) //for the second half of the fade, decrease linearly
+	{
+		for(uint8_t j = 0; j < 3; j++)
+			displayColour[j] = (uint8_t)((uint32_t)i * colour[j] / (FADE_RESOLUTION - 2));
+		setColour(displayColour);
+		delay(duration/(FADE_RESOLUTION-2));
+	}
+	setColour(black);
+	postEvent(ON_FADE_DONE, 0);
+}
+
+/*************************************************************************************
+ *--------------------------- Colour Fading Overview --------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	The background fading works by using TIMER1 to trigger a regular interrupt, which
+ *	changes the colour. The timer will interrupt 256 timer per complete colour change,
+ *	with a minimum (theoretical) colour change speed of 256us and a maximum of
+ *	65535ms. setFadeRate() can cap the interrupt rate instead, giving each colour
+ *	change fewer interrupts the shorter it is.
+ *
+ *  For the setup of the colour fading, we use a 2d array provided by the user, this
+ *  should adhere to the following format:
+ *
+ *		{ Colour_1_Red, Colour_1_Green, Colour_1_Blue, Duration_1 },
+ *		{ Colour_2_Red, Colour_2_Green, Colour_2_Blue, Duration_2 },
+ *								  ...
+ * 		{ Colour_N_Red, Colour_N_Green, Colour_N_Blue, Duration_N }
+ *
+ * 	Where 'Duration_(X)' refers to the duration of the fade from Colour_(X) to
+ * 	Colour_(X+1).
+ *
+ * 	A colour can also be given as HSV(Hue, Saturation, Value), all 0 -> 255. Between
+ * 	two HSV colours the fade goes forwards round the colour wheel rather than in a
+ * 	straight line between the two RGB colours, and if both are the same it goes all
+ * 	the way round, so a single HSV colour gives a full rainbow:
+ *
+ * 		{ HSV(0, 255, 255), 7000 },
+ * 		{ ENDCYCLE }
+ *
+ * 	It takes this data and uses it to build a loop of CycleType_t's. These are a
+ * 	custom type which each contain the colour, a duration, and a pointer to the
+ * 	next CycleType_t in the loop. The final node in the loop points back to the
+ * 	first node (hence making it a loop).
+ *
+ * 	There are 2 global CycleType_t's, which are:
+ *
+ * 		CycleType_t *currentNode; - The node we are currently interacting with
+ * 		CycleType_t *entryNode;   - A node populated with the current colour at the
+ * 							        time of the fade being initialised, which points
+ * 							        to the 'first' node of the loop.
+ *
+ * 	These serve as the basis for all interaction with the loop.
+ *
+ * 	There are also 2 other globals which are needed for the colour fading, there are:
+ *
+ *  	uint8_t[3] currentFadeColour - this holds the current colour of the fade.
+ *  	uint32_t timerCount 		 - this is incremented on each isr call and is
+ *  						  		   used for tracking when we need to swap from one
+ *  						  		   colour to the next.
+ *
+ * 	The fading itself is done in the following manner:
+ * 	1) The user calls setFade with the setup array.
+ * 	2) The loop is set up and all the types are populated. - setFade()
+ * 	3) The timer is set up with a prescaler determined by the duration of the first
+ * 	   node of the cycle. It will run at the max speed it can without overflowing
+ * 	   the timer - this increases the resolution of the timing and thus the overall
+ * 	   accuracy. The timer runs in CTC mode, clearing itself when it reaches OCR1A,
+ * 	   so the time the ISR takes to start isn't lost. - timerSetup()
+ * 	4) The interrupt is enabled.
+ * 	5) On the interrupt, it fetches values from the node and the cos fade table
+ * 	   which it uses to compute the colour change required. Once this change has been
+ * 	   implemented it incrememnts the counter and checks to see if a node swap is
+ * 	   needed. - isr()
+ * 	6) If a swap is needed then the current node is swapped to the next node, and
+ * 	   the timer values are recalculated and applied without stopping the timer.
+ * 	   - swapNode()
+ * 	7) Finally OCR1A is set for the next tick. The counts for a whole step rarely
+ * 	   divide by FADE_RESOLUTION, so the remainder is shared out one count at a time
+ * 	   between the ticks in the same way as drawing a line (Bresenham), and any part
+ * 	   of a count left at the end of a step is carried into the next. When the
+ * 	   prescaler changes between steps, what the timer counted at the old speed is
+ * 	   taken off the new step and the timer restarted from 0. Each step then takes
+ * 	   exactly its duration, to within a timer period, and the loop doesn't drift
+ * 	   however many times it goes round. - nextTick()
+ *
+ *
+ ************************************************************************************/
+
+
+/*************************************************************************************
+ * Name: 	setFade(uint8_t setup[][4], uint8_t numberOfColours, uint8_t fadeInTime)
+ *
+ * Params:	uint8_t setup[][4] 		- the setup array for the fade
+ * 			uint8_t numberOfColours - the number of colours in the fade
+ * 			uint8_t fadeInTime		- the time taken to fade in to the fade
+ *
+ * Returns: Bool - success or failure (failure usually caused by not enough memory).
+ *
+ * Desc:	Starts a background colour fade.
+ ************************************************************************************/
+bool backlight::setFade(int setup[][4], int fadeInTime)
+{
+	return setFade(setup, NULL, fadeInTime);
+}
+
+/*************************************************************************************
+ * Name: 	setFade(int setup[][4], const uint16_t *curves[], int fadeInTime)
+ *
+ * Params:	int setup[][4] 				- the setup array for the fade
+ * 			const uint16_t *curves[]	- the curve for each colour in the setup array,
+ * 										  EASE_COSINE etc. NULL uses EASE_COSINE.
+ * 			int fadeInTime				- the time taken to fade in to the fade
+ *
+ * Returns: Bool - success or failure (failure usually caused by not enough memory).
+ *
+ * Desc:	Starts a background colour fade, with its own curve for each step.
+ ************************************************************************************/
+bool backlight::setFade(int setup[][4], const uint16_t *curves[], int fadeInTime)
+{
+	collect();
+
+	/* Determine length of array */
+	uint8_t i = 0;
+	while(setup[i++][3] != 0)
+		if(i == 0) return false; //if it wraps
+
+	//if the array consists of only ENDCYCLE
+	if(i == 1) return false;
+
+	//get the memory for the first node
+	backlight::CycleType_t *root = (backlight::CycleType_t *)malloc(sizeof(backlight::CycleType_t));
+
+	//check we have enough
+	if(root == NULL) return false;
+
+	//will hold the final pointer we need to wrap the loop
+	backlight::CycleType_t *loopNode = buildLoop(root, setup, curves, 0, i-2);
+
+	/* make setup into a loop of cycletype_t */
+	if(NULL == loopNode)
+	{
+		free((void *)root);
+		return false;
+	}
+
+	/* wrap the loop */
+	loopNode->next = root;
+
+	/* Create entry node */
+	backlight::CycleType_t *newEntry = (backlight::CycleType_t *)malloc(sizeof(backlight::CycleType_t));
+	if(newEntry == NULL)
+	{
+		freeLoop(root, loopNode);
+		return false;
+	}
+
+	newEntry->duration = fadeInTime;
+	newEntry->curve = cosFade;
+	newEntry->next = root;
+
+	/* if we're already fading, the ISR swaps to the new loop at the end of this segment */
+	if(fade_running())
+	{
+		uint8_t oldSREG = SREG;
+		cli();
+		backlight::CycleType_t *unused = pendingEntry;
+		pendingEntry = newEntry;
+		SREG = oldSREG;
+
+		if(unused != NULL) freeProgram(unused); //replaced before it was picked up
+		return true;
+	}
+
+	/* copy current colour to entry colour */
+	memcpy((void*)newEntry->colour, (void *)currentColour, 3);
+	newEntry->mode = FADE_RGB;
+
+	entry = newEntry;
+	currentNode = entry;
+	nextNode = entry->next;
+	currentStep = FADE_IN_STEP;
+	_syncRemaining = entry->duration;
+
+	/* reset the globals */
+	timerCount = 0;
+	_halfUsCarry = 0;
+
+	/* stopped, so whatever TCNT1 holds isn't part of the fade */
+	TCCR1A = 0;
+	TCCR1B = 0;
+	timerSetup();
+	TCNT1 = 0;
+	nextTick();
+
+
+	/* set pwm timers running */
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		if (currentColour[i] == 0)
+			analogWrite(_pins[i], 254);
+		else if(currentColour[i] == 255)
+			analogWrite(_pins[i], 1);
+	}
+	
+	TIMSK1 |= (1 << OCIE1A);
+
+	return true;
+
+}
+
+/*************************************************************************************
+ * Name: 	buildLoop(backlight::CycleType_t *node, int setup[][4],
+ * 					  const uint16_t *curves[], uint8_t index, uint8_t max)
+ *
+ * Params:	CycleType_t *node		- the first node, already allocated.
+ * 			int setup[][4]			- the setup array
+ * 			uint16_t *curves[]		- the curve for each node, may be NULL
+ * 			uint8_t index			- the line of the array for the first node
+ * 			uint8_t max				- the last line of the array
+ *
+ * Returns: CycleType_t * - the last node, with next left NULL for the caller to
+ * 			close the loop, or NULL if there wasn't enough memory.
+ *
+ * Desc:	Builds the nodes of a loop from the setup array, one after another rather
+ * 			than recursing, so the stack used doesn't grow with the length of the
+ * 			loop. If it runs out of memory every node it allocated is freed again,
+ * 			leaving just the first node for the caller to free.
+ ************************************************************************************/
+backlight::CycleType_t *backlight::buildLoop(backlight::CycleType_t *node, int setup[][4], const uint16_t *curves[], uint8_t index, uint8_t max)
+{
+	backlight::CycleType_t *first = node;
+
+	for(;; index++)
+	{
+		/* Populate node cycletype with the colour */
+		for(uint8_t i = 0; i < 3; i++)
+			node->colour[i] = setup[index][i];
+		node->mode = (setup[index][0] & 0x100) ? FADE_HSV : FADE_RGB; //see HSV()
+
+		/*Populate node cycletype with the duration */
+		node->duration = setup[index][3];
+
+		/* and the curve to the next colour */
+		node->curve = (curves != NULL && curves[index] != NULL) ? curves[index] : cosFade;
+		node->next = NULL;
+
+		/* Last node */
+		if(index == max)
+			return node;
+
+		/* Create the next node */
+		backlight::CycleType_t *next = (backlight::CycleType_t *)malloc(sizeof(backlight::CycleType_t));
+
+		/* No memory!! give back everything after the first node */
+		if(next == NULL)
+		{
+			node = first->next;
+			while(node != NULL)
+			{
+				next = node->next;
+				free((void *)node);
+				node = next;
+			}
+			first->next = NULL;
+			return NULL;
+		}
+
+		node->next = next;
+		node = next;
+	}
+}
+
+/*************************************************************************************
+ * Name: 	freeLoop(backlight::CycleType_t *node,
+ * 					 backlight::CycleType_t *endNode)
+ *
+ * Params:	CycleType_t *node		- the first node to free.
+ * 			CycleType_t *endNode  	- the last node to free.
+ *
+ * Returns: None.
+ *
+ * Desc:	Walks the loop from node to endNode, freeing the memory as it goes.
+ ************************************************************************************/
+void backlight::freeLoop(backlight::CycleType_t *node, backlight::CycleType_t *endNode)
+{
+	backlight::CycleType_t *stop = endNode->next; //read before endNode is freed
+
+	do
+	{
+		backlight::CycleType_t *next = node->next;
+		free((void *)node);
+		node = next;
+	} while(node != stop);
+}
+
+/*************************************************************************************
+ *------------------------- Editing a Running Fade Overview -------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	The loop can be changed while the ISR is running through it, without stopping
+ *	the fade. The rules that keep this safe are:
+ *
+ *	1) Only the sketch side changes the loop, the ISR only ever reads it. Each change
+ *	   is published with a single pointer (or colour) write with interrupts off, so
+ *	   the ISR sees either the old loop or the new one, never half of each.
+ *	2) The ISR latches nextNode at the start of each segment and fades towards that,
+ *	   so a change to the step it is heading for takes effect at the end of the
+ *	   current segment rather than jumping part way through.
+ *	3) Nothing the ISR could still be using is freed straight away. Removed and
+ *	   replaced steps go in retired[] and a replaced loop in retiredEntry, and
+ *	   collect() frees them from the sketch side once the ISR has moved past them.
+ *	   collect() is called at the start of each of the editing functions.
+ *	4) Steps are never changed in place. setFadeStep() swaps a new node in, so a
+ *	   segment the ISR is part way through always finishes as it started.
+ *
+ *	Calling setFade() while a fade is running builds the new loop and leaves it in
+ *	pendingEntry, and at the end of the current segment the ISR fades from there into
+ *	it, taking fadeInTime.
+ *
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	setFadeStep(uint8_t step, const Colour_t &colour, int duration)
+ *
+ * Params:	uint8_t step - the step to change, indexed at 0 as in the setup array
+ * 			const Colour_t &colour - the new colour for the step
+ * 			int duration - the new duration of the step
+ *
+ * Returns: Bool - false if there is no fade running, no such step, there isn't
+ * 			enough memory, or too many replaced steps are still waiting to be freed.
+ *
+ * Desc:	Changes a step of the running fade. The step is replaced by a new node
+ * 			rather than changed in place, so if the ISR is fading from or towards it
+ * 			that segment finishes as it started, and the change shows from the next
+ * 			time round the loop.
+ ************************************************************************************/
+bool backlight::setFadeStep(uint8_t step, const Colour_t &colour, int duration)
+{
+	collect();
+	if(entry == NULL) return false;
+
+	uint8_t count;
+	backlight::CycleType_t *prev = stepBefore(step, &count);
+	if(step >= count) return false;
+
+	uint8_t slot = 0;
+	while(slot < RETIRED_NODES && retired[slot] != NULL) slot++;
+	if(slot == RETIRED_NODES) return false;
+
+	backlight::CycleType_t *node = (backlight::CycleType_t *)malloc(sizeof(backlight::CycleType_t));
+	if(node == NULL) return false;
+
+	backlight::CycleType_t *old = prev->next;
+	for(uint8_t i = 0; i < 3; i++)
+		node->colour[i] = colour[i];
+	node->mode = (colour[0] & 0x100) ? FADE_HSV : FADE_RGB;
+	node->duration = duration;
+	node->curve = old->curve;
+	node->next = old->next;
+
+	/* swap it in - anything still pointing at the old node carries on with it */
+	uint8_t oldSREG = SREG;
+	cli();
+	if(prev == old) node->next = node; //the only step
+	prev->next = node;
+	if(entry->next == old) entry->next = node;
+	for(uint8_t i = 0; i < RETIRED_NODES; i++)
+		if(retired[i] != NULL && retired[i]->next == old)
+			retired[i]->next = node;
+	retired[slot] = old;
+	SREG = oldSREG;
+
+	return true;
+}
+
+/*************************************************************************************
+ * Name: 	insertFadeStep(uint8_t step, const Colour_t &colour, int duration)
+ *
+ * Params:	uint8_t step - where the new step goes, indexed at 0 as in the setup array
+ * 			const Colour_t &colour - the colour for the step
+ * 			int duration - the duration of the step
+ *
+ * Returns: Bool - false if there is no fade running, step is past the end of the
+ * 			loop or there isn't enough memory.
+ *
+ * Desc:	Adds a step to the running fade. Steps from step onwards move up one.
+ ************************************************************************************/
+bool backlight::insertFadeStep(uint8_t step, const Colour_t &colour, int duration)
+{
+	collect();
+	if(entry == NULL) return false;
+
+	uint8_t count;
+	backlight::CycleType_t *prev = stepBefore(step, &count);
+	if(step > count) return false;
+
+	backlight::CycleType_t *node = (backlight::CycleType_t *)malloc(sizeof(backlight::CycleType_t));
+	if(node == NULL) return false;
+
+	for(uint8_t i = 0; i < 3; i++)
+		node->colour[i] = colour[i];
+	node->mode = (colour[0] & 0x100) ? FADE_HSV : FADE_RGB;
+	node->duration = duration;
+	node->curve = cosFade;
+	node->next = prev->next;
+
+	/* publish it */
+	uint8_t oldSREG = SREG;
+	cli();
+	prev->next = node;
+	if(step == 0) entry->next = node;
+	SREG = oldSREG;
+
+	return true;
+}
+
+/*************************************************************************************
+ * Name: 	removeFadeStep(uint8_t step)
+ *
+ * Params:	uint8_t step - the step to remove, indexed at 0 as in the setup array
+ *
+ * Returns: Bool - false if there is no fade running, no such step, it is the only
+ * 			step, or too many removed steps are still waiting to be freed.
+ *
+ * Desc:	Removes a step from the running fade.
+ ************************************************************************************/
+bool backlight::removeFadeStep(uint8_t step)
+{
+	collect();
+	if(entry == NULL) return false;
+
+	uint8_t count;
+	backlight::CycleType_t *prev = stepBefore(step, &count);
+	if(step >= count || count == 1) return false;
+
+	uint8_t slot = 0;
+	while(slot < RETIRED_NODES && retired[slot] != NULL) slot++;
+	if(slot == RETIRED_NODES) return false;
+
+	backlight::CycleType_t *node = prev->next;
+
+	/* unpublish it - anything still pointing at it skips over it */
+	uint8_t oldSREG = SREG;
+	cli();
+	prev->next = node->next;
+	if(entry->next == node) entry->next = node->next;
+	for(uint8_t i = 0; i < RETIRED_NODES; i++)
+		if(retired[i] != NULL && retired[i]->next == node)
+			retired[i]->next = node->next;
+	retired[slot] = node;
+	SREG = oldSREG;
+
+	return true;
+}
+
+/*************************************************************************************
+ * Name: 	stepBefore(uint8_t step, uint8_t *count)
+ *
+ * Params:	uint8_t step - the step
+ * 			uint8_t *count - filled with the number of steps in the loop
+ *
+ * Returns: CycleType_t * - the node before the step, wrapping round the loop.
+ *
+ * Desc:	Finds a step in the running fade.
+ ************************************************************************************/
+backlight::CycleType_t *backlight::stepBefore(uint8_t step, uint8_t *count)
+{
+	backlight::CycleType_t *root = entry->next;
+	backlight::CycleType_t *last = root;
+	*count = 1;
+	while(last->next != root)
+	{
+		last = last->next;
+		(*count)++;
+	}
+
+	while(step--)
+		last = last->next;
+	return last;
+}
+
+/*************************************************************************************
+ * Name: 	collect(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Frees anything taken out of the fade that the ISR has finished with.
+ ************************************************************************************/
+void backlight::collect(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	backlight::CycleType_t *program = retiredEntry;
+	retiredEntry = NULL;
+	backlight::CycleType_t *current = currentNode;
+	backlight::CycleType_t *next = nextNode;
+	SREG = oldSREG;
+
+	if(program != NULL) freeProgram(program);
+
+	for(uint8_t i = 0; i < RETIRED_NODES; i++)
+		if(retired[i] != NULL && retired[i] != current && retired[i] != next)
+		{
+			free((void *)retired[i]);
+			retired[i] = NULL;
+		}
+}
+
+/*************************************************************************************
+ * Name: 	freeProgram(backlight::CycleType_t *program)
+ *
+ * Params:	CycleType_t *program - the entry node of the loop
+ *
+ * Returns: None.
+ *
+ * Desc:	Frees a whole loop and its entry node.
+ ************************************************************************************/
+void backlight::freeProgram(backlight::CycleType_t *program)
+{
+	freeLoop(program->next, program);
+	free((void *)program);
+}
+
+/*************************************************************************************
+ *----------------------------- Fade Events Overview --------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	The sketch can ask to be told when:
+ *
+ *		ON_SEGMENT   - the fade moves on to the next step. The callback gets the step
+ *					   number, counting from 0 at the first line of the setup array,
+ *					   or FADE_IN_STEP for the fade in. Steps inserted or removed
+ *					   behind the current one are counted from the next time round.
+ *		ON_CYCLE	 - the fade has gone back round to the first step.
+ *		ON_FADE_DONE - crossFade(), fadeIn() or fadeOut() has finished. stopFade()
+ *					   fades out through crossFade() so this comes at the end of that.
+ *
+ *	The ISR doesn't call these itself, as they would run with interrupts off and hold
+ *	up the fade. It puts them on _fadeEvents instead, and update() - called from
+ *	loop() - takes them off and calls the callbacks. Events are dropped if the queue
+ *	fills up before update() is called.
+ *
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	setCallback(uint8_t event, FadeCallback_t callback)
+ *
+ * Params:	uint8_t event - ON_SEGMENT, ON_CYCLE or ON_FADE_DONE
+ * 			FadeCallback_t callback - the function to call, NULL to stop calling one
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets the function called from update() when the event happens.
+ ************************************************************************************/
+void backlight::setCallback(uint8_t event, FadeCallback_t callback)
+{
+	if(event < FADE_EVENTS)
+		_fadeCallback[event] = callback;
+}
+
+/*************************************************************************************
+ * Name: 	update(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Calls the callbacks for any fade events since the last call. Call this
+ * 			from loop().
+ ************************************************************************************/
+void backlight::update(void)
+{
+	while(_fadeEventCount)
+	{
+		uint8_t oldSREG = SREG;
+		cli();
+		uint8_t event = _fadeEvents[_fadeEventHead][0];
+		uint8_t step = _fadeEvents[_fadeEventHead][1];
+		_fadeEventHead = (_fadeEventHead + 1) & (FADE_EVENT_QUEUE_SIZE - 1);
+		_fadeEventCount--;
+		SREG = oldSREG;
+
+		if(_fadeCallback[event] != NULL)
+			_fadeCallback[event](step);
+	}
+}
+
+/*************************************************************************************
+ * Name: 	postEvent(uint8_t event, uint8_t step)
+ *
+ * Params:	uint8_t event - the event
+ * 			uint8_t step - the step number for ON_SEGMENT
+ *
+ * Returns: None.
+ *
+ * Desc:	Queues an event for update(). Safe to call from the ISR or the sketch.
+ ************************************************************************************/
+void backlight::postEvent(uint8_t event, uint8_t step)
+{
+	if(_fadeCallback[event] == NULL) return; //nobody listening
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if(_fadeEventCount < FADE_EVENT_QUEUE_SIZE)
+	{
+		uint8_t tail = (_fadeEventHead + _fadeEventCount) & (FADE_EVENT_QUEUE_SIZE - 1);
+		_fadeEvents[tail][0] = event;
+		_fadeEvents[tail][1] = step;
+		_fadeEventCount++;
+	}
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ *------------------------------- Fade Sync Overview --------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	Normally TIMER1 decides when each step ends, after its last tick.
+ *	With setFadeSync() the durations in the setup array (and the fade in time) are
+ *	counted in seconds, minutes or hours of the nixie clock instead, and the clock
+ *	decides:
+ *
+ *	1) TIMER1 is set up to get through the step 1/64 faster than the clock will, and
+ *	   once it reaches the end it holds the colour rather than moving on. If the
+ *	   step is longer than TIMER1 can time (about 17 minutes at 256 ticks a
+ *	   step) it fades as slowly as it can and holds for the rest.
+ *	2) The nixie timekeeping calls clockTick() every second. Each time the unit
+ *	   being synced to changes, _syncRemaining counts down, and when it gets to 0
+ *	   the step is finished off and the next one started there and then.
+ *
+ *	So the steps always change on the tick that changes the digits, e.g. a colour
+ *	change with every second or a step round the colour wheel every minute. This
+ *	needs nixie timekeeping on, see setTimekeeping().
+ *
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	setFadeSync(uint8_t unit)
+ *
+ * Params:	uint8_t unit - SYNC_SECONDS, SYNC_MINUTES, SYNC_HOURS or SYNC_OFF for ms
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets what the fade durations are counted in. Call before setFade().
+ ************************************************************************************/
+void backlight::setFadeSync(uint8_t unit)
+{
+	if(unit > SYNC_HOURS) return;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	_syncUnit = unit;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	clockTick(uint8_t unit)
+ *
+ * Params:	uint8_t unit - the largest unit of the time that has just changed
+ *
+ * Returns: None.
+ *
+ * Desc:	Called by the nixie timekeeping every second, from the shared tick. Ends
+ * 			the current step if it is synced and its time is up.
+ ************************************************************************************/
+void backlight::clockTick(uint8_t unit)
+{
+	if(_syncUnit == SYNC_OFF || unit < _syncUnit || !fade_running()) return;
+
+	if(_syncRemaining > 1)
+	{
+		_syncRemaining--;
+		return;
+	}
+
+	/* finish the step off where TIMER1 has got to, and move on */
+	timerCount = _segmentTicks - 1;
+	isr();
+	TCNT1 = 0;
+	swapNode();
+	nextTick();
+}
+
+/*************************************************************************************
+ * Name: 	swapNode(backlight::CycleType_t *node)
+ *
+ * Params:	CycleType_t	*node - the current node
+ *
+ * Returns: None.
+ *
+ * Desc:	Swaps one node to the next.
+ ************************************************************************************/
+void backlight::swapNode()
+{
+	/* swap the node */
+	bool fadingIn = (currentNode == entry);
+	currentNode = nextNode;
+
+	/* pick up a new loop from setFade() */
+	if(pendingEntry != NULL && retiredEntry == NULL)
+	{
+		memcpy((void *)pendingEntry->colour, (void *)currentNode->colour, 3);
+		pendingEntry->mode = currentNode->mode;
+		retiredEntry = entry; //freed by collect()
+		entry = pendingEntry;
+		pendingEntry = NULL;
+		currentNode = entry;
+	}
+
+	/* steps edited from here on take effect at the end of this one */
+	nextNode = currentNode->next;
+
+	/* let the sketch know */
+	if(currentNode == entry)
+		currentStep = FADE_IN_STEP;
+	else if(currentNode == entry->next)
+	{
+		if(!fadingIn) postEvent(ON_CYCLE, 0);
+		currentStep = 0;
+	}
+	else
+		currentStep++;
+	postEvent(ON_SEGMENT, currentStep);
+
+	_syncRemaining = currentNode->duration;
+
+	/* reset everything - the timer keeps running so no time is lost */
+	timerSetup();
+	timerCount = 0;
+
+	return;
+}
+
+/*************************************************************************************
+ * Name: 	timerSetup(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Configures the timer for the current node. A step too short for its
+ * 			ticks to get MIN_TICK_COUNTS each is given fewer ticks, down to
+ * 			FADE_MIN_TICKS, rather than being lengthened.
+ ************************************************************************************/
+void backlight::timerSetup(void)
+{
+	uint32_t msCycleTime = currentNode->duration;
+
+	/* as far as the timer can go, for a usCycleTime that fits in 32 bits */
+	if(_syncUnit != SYNC_OFF)
+	{
+		uint32_t unitMs = pgm_read_dword(&syncUnitMs[_syncUnit]);
+		if(msCycleTime > 4000000UL / unitMs)
+			msCycleTime = 4000000UL;
+		else
+			msCycleTime *= unitMs;
+	}
+	if(msCycleTime == 0) msCycleTime = 1;
+
+	/* choose the number of ticks, the most that fit in the rate cap */
+	uint32_t ticks = FADE_RESOLUTION;
+	_tickShift = 0;
+	if(_maxTickRate)
+	{
+		ticks <<= FADE_MAX_SHIFT;
+		_tickShift = FADE_MAX_SHIFT;
+		while(ticks > FADE_MIN_TICKS && ticks * 1000 / msCycleTime > _maxTickRate)
+		{
+			ticks >>= 1;
+			_tickShift--;
+		}
+	}
+
+	/* and fewer for short steps, so each tick gets MIN_TICK_COUNTS at 0.5us a count */
+	while(ticks > FADE_MIN_TICKS && ticks * (MIN_TICK_COUNTS / 2) > msCycleTime * 1000)
+	{
+		ticks >>= 1;
+		_tickShift--;
+	}
+	_segmentTicks = ticks;
+	_tickRate = (uint32_t)_segmentTicks * 1000 / msCycleTime;
+
+	/* run a little fast and wait for the clock at the end, no more than 4s a tick */
+	if(_syncUnit != SYNC_OFF)
+	{
+		msCycleTime -= msCycleTime >> 6;
+		if(msCycleTime > 4000UL * _segmentTicks)
+			msCycleTime = 4000UL * _segmentTicks;
+	}
+
+	uint32_t usCycleTime = msCycleTime * 1000;
+	uint32_t usTickTime = usCycleTime / _segmentTicks;
+	uint8_t prescaler, shift;
+
+	/* Work out prescaler for the step, the period being 0.5us << shift */
+	if 	(usTickTime < 0x00007FFF) { //2MHz
+		prescaler = (1 << CS11);
+		shift = 0;
+	} else if (usTickTime < 0x0003FFFF) { //250KHz
+		prescaler = (1 << CS10 | 1 << CS11);
+		shift = 3;
+	} else if (usTickTime < 0x000FFFFF) { //62.5KHz
+		prescaler = (1 << CS12);
+		shift = 5;
+	} else { //15.625KHz
+		prescaler = (1 << CS10 | 1 << CS12);
+		shift = 7;
+	}
+
+	/*
+	 * The timer has been counting since the compare match that ended the last step.
+	 * At a new speed what it holds would be read in the wrong units, so take the
+	 * time it has counted off this step and start it again from 0.
+	 */
+	int32_t halfUs = _halfUsCarry;
+	uint8_t running = TCCR1B & (1 << CS10 | 1 << CS11 | 1 << CS12);
+	if(running && running != prescaler)
+	{
+		halfUs -= (uint32_t)TCNT1 << _periodShift;
+		TCNT1 = 0;
+	}
+	_periodShift = shift;
+
+	/* the counts for the whole step, kept in 32 bits by only doubling the part under a count */
+	uint32_t counts;
+	if(shift == 0)
+	{
+		counts = (usCycleTime << 1) + halfUs;
+		_halfUsCarry = 0;
+	}
+	else
+	{
+		halfUs += (usCycleTime & ((1UL << (shift - 1)) - 1)) << 1;
+		counts = (usCycleTime >> (shift - 1)) + (halfUs >> shift); //floors when negative
+		_halfUsCarry = halfUs & ((1 << shift) - 1);
+	}
+
+	/* share them out between the ticks */
+	_tickCounts = counts / _segmentTicks;
+	_tickExtra = counts % _segmentTicks;
+	_tickError = 0;
+
+	/*
+	 * With the ticks cut down above, only a step shortened by the time the ISR took
+	 * to get here can come in under, and it is lengthened to MIN_TICK_COUNTS a tick
+	 * rather than let the ISR fall behind the timer.
+	 */
+	if(_tickCounts < MIN_TICK_COUNTS)
+	{
+		_tickCounts = MIN_TICK_COUNTS;
+		_tickExtra = 0;
+	}
+
+	/* clear timer on compare match with OCR1A, changing speed without stopping */
+	TCCR1B = (1 << WGM12) | prescaler;
+}
+
+/*************************************************************************************
+ * Name: 	getFade(int setup[][4], uint8_t max)
+ *
+ * Params:	int setup[][4] - filled with the running fade, in the same form as for
+ * 							 setFade() but without the ENDCYCLE
+ * 			uint8_t max - the most steps to fill in
+ *
+ * Returns: uint8_t - the number of steps filled in, 0 if there is no fade running.
+ *
+ * Desc:	Gets the steps of the running fade.
+ ************************************************************************************/
+uint8_t backlight::getFade(int setup[][4], uint8_t max)
+{
+	return getFade(setup, NULL, max);
+}
+
+/*************************************************************************************
+ * Name: 	getFade(int setup[][4], const uint16_t *curves[], uint8_t max)
+ *
+ * Params:	int setup[][4] - filled with the running fade, in the same form as for
+ * 							 setFade() but without the ENDCYCLE
+ * 			const uint16_t *curves[] - filled with the curve of each step, or NULL
+ * 			uint8_t max - the most steps to fill in
+ *
+ * Returns: uint8_t - the number of steps filled in, 0 if there is no fade running.
+ *
+ * Desc:	Gets the steps of the running fade. If setFade() has been given a new one
+ * 			that is waiting for the end of the current step, that is the one filled
+ * 			in, as it is what will be running.
+ ************************************************************************************/
+uint8_t backlight::getFade(int setup[][4], const uint16_t *curves[], uint8_t max)
+{
+	collect();
+
+	/* the ISR only ever moves pendingEntry over to entry, so either is safe to walk */
+	uint8_t oldSREG = SREG;
+	cli();
+	backlight::CycleType_t *program = (pendingEntry != NULL) ? pendingEntry : entry;
+	SREG = oldSREG;
+	if(program == NULL) return 0;
+
+	backlight::CycleType_t *root = program->next;
+	backlight::CycleType_t *node = root;
+	uint8_t steps = 0;
+	do
+	{
+		for(uint8_t j = 0; j < 3; j++)
+			setup[steps][j] = node->colour[j];
+		if(node->mode == FADE_HSV) setup[steps][0] |= 0x100;
+		setup[steps][3] = node->duration;
+		if(curves != NULL) curves[steps] = node->curve;
+		node = node->next;
+	} while(++steps < max && node != root);
+
+	return steps;
+}
+
+/*************************************************************************************
+ * Name: 	setFadeRate(uint16_t maxHz)
+ *
+ * Params:	uint16_t maxHz - the most fade interrupts a second, 0 for FADE_RESOLUTION
+ * 							 every step whatever its length
+ *
+ * Returns: None.
+ *
+ * Desc:	Caps how often the fade interrupts, taking effect from the next step.
+ * 			Each step gets the most ticks that fit under the cap, as a power of 2
+ * 			from FADE_MIN_TICKS to 4 times FADE_RESOLUTION. Short steps stride
+ * 			through the fade table so they don't starve the rest of the sketch, and
+ * 			long ones go between its points so the colour changes too slowly to see
+ * 			each step.
+ ************************************************************************************/
+void backlight::setFadeRate(uint16_t maxHz)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	_maxTickRate = maxHz;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	getFadeRate(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint32_t - fade interrupts a second in the current step. With no cap a
+ * 			step of a few ms runs at more than 65535.
+ *
+ * Desc:	Gets the rate the fade is running at.
+ ************************************************************************************/
+uint32_t backlight::getFadeRate(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	uint32_t rate = _tickRate;
+	SREG = oldSREG;
+	return rate;
+}
+
+/*************************************************************************************
+ * Name: 	nextTick(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets the timer up for the next tick of the step, adding the extra count
+ * 			to the right ticks so the step comes out at exactly its length.
+ ************************************************************************************/
+void backlight::nextTick(void)
+{
+	uint16_t counts = _tickCounts;
+	_tickError += _tickExtra;
+	if(_tickError >= _segmentTicks)
+		_tickError -= _segmentTicks;
+	else
+		counts--; //the timer clears on the count after OCR1A
+
+	OCR1A = counts;
+
+	/* if the ISR has run past it, don't let the timer go all the way round */
+	if(TCNT1 >= counts) TCNT1 = counts - 1;
+}
+
+/*************************************************************************************
+ * Name: 	isr()
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	This is the ISR routine. Updates the colours on the backlight and checks
+ * 			the arrayIndex.
+ ************************************************************************************/
+void backlight::isr()
+{
+	uint8_t current[3], aim[3], disp[3];
+	uint16_t level[3]; //8.8 fixed point, so the fraction makes it through to the output
+
+	/*
+	 * Read the current cos fade value, striding through the table or between its
+	 * points. A stride takes the end of each stretch of the table, so the last tick
+	 * lands on FADE_RESOLUTION-1 like it does without one.
+	 */
+	uint16_t wordFromProgMem;
+	if(_tickShift <= 0)
+		wordFromProgMem = pgm_read_word_near(currentNode->curve + ((timerCount + 1) << -_tickShift) - 1);
+	else
+	{
+		uint16_t index = timerCount >> _tickShift;
+		uint16_t a = pgm_read_word_near(currentNode->curve + index);
+		uint16_t b = (index + 1 < FADE_RESOLUTION) ? pgm_read_word_near(currentNode->curve + index + 1) : 0xFFFF;
+		uint8_t between = timerCount & ((1 << _tickShift) - 1);
+		wordFromProgMem = a + (((int32_t)(b - a) * between) >> _tickShift);
+	}
+
+	if(currentNode->mode == FADE_HSV && nextNode->mode == FADE_HSV)
+	{
+		uint8_t *from = currentNode->colour;
+		uint8_t *to = nextNode->colour;
+
+		/* hue always goes forwards round the wheel, all the way round if the colours match */
+		uint16_t sweep = (uint8_t)(to[0] - from[0]);
+		if(!sweep && from[1] == to[1] && from[2] == to[2]) sweep = 256;
+
+		uint16_t hue = (from[0] << 8) + ((((uint32_t)sweep << 8) * wordFromProgMem) >> 16);
+		uint8_t sat = from[1] + (((int32_t)(to[1] - from[1]) * wordFromProgMem) >> 16);
+		uint8_t val = from[2] + (((int32_t)(to[2] - from[2]) * wordFromProgMem) >> 16);
+		hsvToRgb(hue, sat, val, disp);
+		for(uint8_t j = 0; j < 3; j++)
+			level[j] = disp[j] << 8;
+	}
+	else
+	{
+		nodeColour(currentNode, current);
+		nodeColour(nextNode, aim);
+
+		/* Work out the new colours */
+		for(uint8_t j = 0; j < 3; j++)
+		{
+			level[j] = (current[j] << 8) + (((int32_t)(aim[j] - current[j]) * wordFromProgMem) >> 8);
+			disp[j] = level[j] >> 8;
+		}
+	}
+
+	/* Apply them */
+	_output[0](0, level[0]);
+	_output[1](1, level[1]);
+	_output[2](2, level[2]);
+
+	/* Again reckon this will be quicker but a straightforward assignment may have to do */
+	memcpy((void *)currentFadeColour, (void *)disp, 3*sizeof(uint8_t));
+
+	/* if we need to swap nodes - when synced, the clock does that */
+	if(++timerCount >= _segmentTicks)
+	{
+		if(_syncUnit == SYNC_OFF)
+			swapNode();
+		else
+			timerCount = _segmentTicks - 1;
+	}
+
+	/* and the length of the next tick, which may be in the next step */
+	nextTick();
+
+}
+
+/*************************************************************************************
+ * Name: 	nodeColour(CycleType_t *node, uint8_t rgb[])
+ *
+ * Params:	CycleType_t *node - the node
+ * 			uint8_t rgb[] - filled with the colour of the node
+ *
+ * Returns: None.
+ *
+ * Desc:	Gets the colour of a node as r,g,b whatever mode it is in.
+ ************************************************************************************/
+void backlight::nodeColour(CycleType_t *node, uint8_t rgb[])
+{
+	if(node->mode == FADE_HSV)
+		hsvToRgb(node->colour[0] << 8, node->colour[1], node->colour[2], rgb);
+	else
+		memcpy((void *)rgb, (void *)node->colour, 3*sizeof(uint8_t));
+}
+
+/*************************************************************************************
+ * Name: 	hsvToRgb(uint16_t hue, uint8_t sat, uint8_t val, uint8_t rgb[])
+ *
+ * Params:	uint16_t hue - the hue, 0 -> 65535 for once round the colour wheel
+ * 			uint8_t sat - the saturation
+ * 			uint8_t val - the value
+ * 			uint8_t rgb[] - filled with the colour
+ *
+ * Returns: None.
+ *
+ * Desc:	Integer only HSV to RGB conversion, quick enough to run on every tick.
+ ************************************************************************************/
+void backlight::hsvToRgb(uint16_t hue, uint8_t sat, uint8_t val, uint8_t rgb[])
+{
+	uint32_t sixths = (uint32_t)hue * 6;
+	uint8_t region = sixths >> 16;			//which sixth of the wheel
+	uint8_t along = (sixths >> 8) & 0xFF;	//how far through it
+
+	uint8_t p = (val * (uint16_t)(255 - sat)) >> 8;
+	uint8_t q = (val * (uint16_t)(255 - ((sat * (uint16_t)along) >> 8))) >> 8;
+	uint8_t t = (val * (uint16_t)(255 - ((sat * (uint16_t)(255 - along)) >> 8))) >> 8;
+
+	switch(region)
+	{
+		case 0:  rgb[0] = val; rgb[1] = t;   rgb[2] = p;   break;
+		case 1:  rgb[0] = q;   rgb[1] = val; rgb[2] = p;   break;
+		case 2:  rgb[0] = p;   rgb[1] = val; rgb[2] = t;   break;
+		case 3:  rgb[0] = p;   rgb[1] = q;   rgb[2] = val; break;
+		case 4:  rgb[0] = t;   rgb[1] = p;   rgb[2] = val; break;
+		default: rgb[0] = val; rgb[1] = p;   rgb[2] = q;   break;
+	}
+}
+
+/*************************************************************************************
+ * Name: 	stopFade(const Colour_t &stopColour, int duration)
+ *
+ * Params:	const Colour_t &stopColour - the colour to fade to once stopped.
+ * 			int duration - how long the fade should last.
+ *
+ * Returns: None.
+ *
+ * Desc:	Stops the fade. Detaches the ISR and fades to the colour specified.
+ ************************************************************************************/
+void backlight::stopFade(const Colour_t &stopColour, int duration)
+{
+	/* detach and stop the ISR */
+	TIMSK1 &= ~(1 << OCIE1A);
+	TCCR1B = 0;
+
+	/* free the memory in the loop, and the entry point */
+	if(entry != NULL) freeProgram(entry);
+	entry = NULL;
+
+	/* and anything waiting to be picked up or freed */
+	if(pendingEntry != NULL) freeProgram(pendingEntry);
+	pendingEntry = NULL;
+	currentNode = nextNode = NULL;
+	collect();
+
+	/* Can't use memcpy as int is 16-bit */
+	int tempColour[3] = { currentFadeColour[0], currentFadeColour[1], currentFadeColour[2] };
+
+	/* fade to stop colour */
+	crossFade(tempColour, stopColour, duration);
+}
+
+/*************************************************************************************
+ * Name: 	pwmRegister(uint8_t pin)
+ *
+ * Params:	uint8_t pin - the pin.
+ *
+ * Returns: volatile uint8_t * - the 8 bit Capture/Compare register for the pin, or
+ * 			a dummy register if it doesn't have one.
+ *
+ * Desc:	This finds the register setting the duty of the PWM pins, so that it can
+ * 			be written directly without affecting the state of the timers (unlike
+ * 			AnalogWrite). The PWM timers must be running for writes to it to do
+ * 			anything. Only run once per pin, from the constructor, so that the ISR
+ * 			doesn't have to do this lookup on every tick. Pins on 16 bit timers are
+ * 			found by pwmRegister16().
+ ************************************************************************************/
+volatile uint8_t *backlight::pwmRegister(uint8_t pin)
+{
+	switch(digitalPinToTimer(pin))
+	{
+		#if defined(TCCR0) && defined(COM00) && !defined(__AVR_ATmega8__)
+		case TIMER0A:
+			return &OCR0;
+		#endif
+
+		#if defined(TCCR0A) && defined(COM0A1)
+		case TIMER0A:
+			return &OCR0A;
+		#endif
+
+		#if defined(TCCR0A) && defined(COM0B1)
+		case TIMER0B:
+			return &OCR0B;
+		#endif
+
+		/* TIMER1 is used for the fading */
+
+		#if defined(TCCR2) && defined(COM21)
+		case TIMER2:
+			return &OCR2;
+		#endif
+
+		#if defined(TCCR2A) && defined(COM2A1)
+		case TIMER2A:
+			return &OCR2A;
+		#endif
+
+		#if defined(TCCR2A) && defined(COM2B1)
+		case TIMER2B:
+			return &OCR2B;
+		#endif
+
+		/* 8 bit registers of the high speed TIMER4 (ATmega32U4) */
+		#if defined(TCCR4A) && !defined(ICR4)
+		case TIMER4A:
+			return &OCR4A;
+		#endif
+
+		#if defined(TCCR4A) && defined(COM4B1) && !defined(ICR4)
+		case TIMER4B:
+			return &OCR4B;
+		#endif
+
+		#if defined(TCCR4C) && defined(COM4D1)
+		case TIMER4D:
+			return &OCR4D;
+		#endif
+
+		default:
+			return &_noPwm;
+	}
+}
+
+/*************************************************************************************
+ * Name: 	pwmRegister16(uint8_t pin)
+ *
+ * Params:	uint8_t pin - the pin.
+ *
+ * Returns: volatile uint16_t * - the 16 bit Capture/Compare register for the pin, or
+ * 			NULL if it isn't on a 16 bit timer.
+ *
+ * Desc:	As pwmRegister(), for pins on 16 bit timers. These have to be written all
+ * 			16 bits at a time, as writing just the low byte would also write whatever
+ * 			was last left in the shared high byte register.
+ ************************************************************************************/
+volatile uint16_t *backlight::pwmRegister16(uint8_t pin)
+{
+	switch(digitalPinToTimer(pin))
+	{
+		#if defined(TCCR3A) && defined(COM3A1)
+		case TIMER3A:
+			return &OCR3A;
+		#endif
+
+		#if defined(TCCR3A) && defined(COM3B1)
+		case TIMER3B:
+			return &OCR3B;
+		#endif
+
+		#if defined(TCCR3A) && defined(COM3C1)
+		case TIMER3C:
+			return &OCR3C;
+		#endif
+
+		#if defined(TCCR4A) && defined(ICR4)
+		case TIMER4A:
+			return &OCR4A;
+		#endif
+
+		#if defined(TCCR4A) && defined(COM4B1) && defined(ICR4)
+		case TIMER4B:
+			return &OCR4B;
+		#endif
+
+		#if defined(TCCR4A) && defined(COM4C1) && defined(ICR4)
+		case TIMER4C:
+			return &OCR4C;
+		#endif
+
+		#if defined(TCCR5A) && defined(COM5A1)
+		case TIMER5A:
+			return &OCR5A;
+		#endif
+
+		#if defined(TCCR5A) && defined(COM5B1)
+		case TIMER5B:
+			return &OCR5B;
+		#endif
+
+		#if defined(TCCR5A) && defined(COM5C1)
+		case TIMER5C:
+			return &OCR5C;
+		#endif
+
+		default:
+			return NULL;
+	}
+}
+
+/*************************************************************************************
+ *------------------------------- Buttons Overview ----------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	Up to BUTTON_COUNT buttons are read on every shared tick, straight from the input
+ *	register rather than with digitalRead(). Each has an integrator which counts up
+ *	while the pin reads pressed and down while it reads released; the button only
+ *	changes state when the integrator gets all the way to BUTTON_INTEGRATOR or back
+ *	to 0, so bounce (and noise) just moves it up and down in between.
+ *
+ *	Once pressed, the ticks it is held for are counted, giving:
+ *
+ *		BUTTON_PRESS	  - as soon as it has settled down
+ *		BUTTON_LONG_PRESS - once it has been held for the long press time
+ *		BUTTON_REPEAT	  - every repeat time after that, for as long as it is held
+ *		BUTTON_RELEASE	  - once it has settled back up
+ *
+ *	Events go on a queue for the sketch to take off with getEvent() whenever it gets
+ *	round to it, and are dropped if the queue is full. Buttons are numbered from 0
+ *	in the order given to the constructor. Only one set of buttons can be serviced
+ *	by the tick, the last one made.
+ *
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	buttons(int pin1, int pin2, int pin3, int pin4)
+ *
+ * Params:	int pin1 - the pin of button 0
+ * 			int pin2 - the pin of button 1, or NO_BUTTON
+ * 			int pin3 - the pin of button 2, or NO_BUTTON
+ * 			int pin4 - the pin of button 3, or NO_BUTTON
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets up the buttons and starts reading them. They are taken to connect
+ * 			to +5V with a pull down, see setActiveLow() for the other way round.
+ ************************************************************************************/
+buttons::buttons(int pin1, int pin2, int pin3, int pin4)
+{
+	addButton(pin1);
+	addButton(pin2);
+	addButton(pin3);
+	addButton(pin4);
+	setLongPress(1000);
+	setRepeat(250);
+	tick_trace_setup();
+
+	/* start the shared tick */
+	bt = this;
+	TIMSK0 |= (1 << OCIE0A);
+}
+
+/*************************************************************************************
+ * Name: 	addButton(int pin)
+ *
+ * Params:	int pin - the pin, or NO_BUTTON
+ *
+ * Returns: None.
+ *
+ * Desc:	Adds a button to the set.
+ ************************************************************************************/
+void buttons::addButton(int pin)
+{
+	if(pin == NO_BUTTON || _count == BUTTON_COUNT) return;
+
+	ButtonType_t *button = &_button[_count];
+	pinMode(pin, INPUT);
+	button->pin = pin;
+	button->port = portInputRegister(digitalPinToPort(pin));
+	button->mask = digitalPinToBitMask(pin);
+	button->integrator = 0;
+	button->pressed = 0;
+	button->held = 0;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	_count++;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	setActiveLow(bool state)
+ *
+ * Params:	bool state - true for buttons which connect to ground
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets which way round the buttons are. Active low buttons use the internal
+ * 			pull up, so need nothing else.
+ ************************************************************************************/
+void buttons::setActiveLow(bool state)
+{
+	_activeLow = state;
+
+	for(uint8_t i = 0; i < _count; i++)
+		pinMode(_button[i].pin, state ? INPUT_PULLUP : INPUT);
+}
+
+/*************************************************************************************
+ * Name: 	setLongPress(uint16_t ms)
+ *
+ * Params:	uint16_t ms - how long a button is held for a long press
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets the long press time.
+ ************************************************************************************/
+void buttons::setLongPress(uint16_t ms)
+{
+	uint16_t ticks = (uint32_t)ms * 1000 / TICK_US;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	_longTicks = ticks;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	setRepeat(uint16_t ms)
+ *
+ * Params:	uint16_t ms - time between repeats after a long press, 0 for no repeats
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets the auto-repeat time.
+ ************************************************************************************/
+void buttons::setRepeat(uint16_t ms)
+{
+	uint16_t ticks = (uint32_t)ms * 1000 / TICK_US;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	_repeatTicks = ticks;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	isPressed(uint8_t button)
+ *
+ * Params:	uint8_t button - the button
+ *
+ * Returns: Bool - whether the button is held down, after debouncing.
+ *
+ * Desc:	Reads the state of a button.
+ ************************************************************************************/
+bool buttons::isPressed(uint8_t button)
+{
+	if(button >= _count) return 0;
+	return _button[button].pressed;
+}
+
+/*************************************************************************************
+ * Name: 	available(void)
+ *
+ * Params:	None.
+ *
+ * Returns: uint8_t - the number of events waiting.
+ *
+ * Desc:	Checks for button events.
+ ************************************************************************************/
+uint8_t buttons::available(void)
+{
+	return _eventCount;
+}
+
+/*************************************************************************************
+ * Name: 	getEvent(uint8_t *button, uint8_t *event)
+ *
+ * Params:	uint8_t *button - filled with the button
+ * 			uint8_t *event - filled with BUTTON_PRESS, BUTTON_LONG_PRESS,
+ * 							 BUTTON_REPEAT or BUTTON_RELEASE
+ *
+ * Returns: Bool - false if there were no events waiting.
+ *
+ * Desc:	Takes the oldest event off the queue.
+ ************************************************************************************/
+bool buttons::getEvent(uint8_t *button, uint8_t *event)
+{
+	if(!_eventCount) return 0;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	uint8_t e = _events[_eventHead];
+	_eventHead = (_eventHead + 1) & (BUTTON_QUEUE_SIZE - 1);
+	_eventCount--;
+	SREG = oldSREG;
+
+	*button = e >> 4;
+	*event = e & 0x0F;
+	return 1;
+}
+
+/*************************************************************************************
+ * Name: 	clearEvents(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Throws away any events waiting.
+ ************************************************************************************/
+void buttons::clearEvents(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	_eventCount = 0;
+	SREG = oldSREG;
+}
+
+/*************************************************************************************
+ * Name: 	postEvent(uint8_t button, uint8_t event)
+ *
+ * Params:	uint8_t button - the button
+ * 			uint8_t event - the event
+ *
+ * Returns: None.
+ *
+ * Desc:	Queues an event, from the shared tick.
+ ************************************************************************************/
+void buttons::postEvent(uint8_t button, uint8_t event)
+{
+	if(_eventCount == BUTTON_QUEUE_SIZE) return;
+
+	uint8_t tail = (_eventHead + _eventCount) & (BUTTON_QUEUE_SIZE - 1);
+	_events[tail] = (button << 4) | event;
+	_eventCount++;
+}
+
+/*************************************************************************************
+ * Name: 	tick(void)
+ *
+ * Params:	None.
+ *
+ * Returns: None.
+ *
+ * Desc:	Called from the shared tick. Reads and debounces the buttons.
+ ************************************************************************************/
+void buttons::tick(void)
+{
+	for(uint8_t i = 0; i < _count; i++)
+	{
+		ButtonType_t *button = &_button[i];
+
+		/* integrate */
+		bool down = ((*button->port & button->mask) != 0) != _activeLow;
+		if(down)
+		{
+			if(button->integrator < BUTTON_INTEGRATOR) button->integrator++;
+		}
+		else if(button->integrator)
+			button->integrator--;
+
+		/* then see what has changed */
+		if(!button->pressed)
+		{
+			if(button->integrator == BUTTON_INTEGRATOR)
+			{
+				button->pressed = 1;
+				button->held = 0;
+				postEvent(i, BUTTON_PRESS);
+			}
+		}
+		else if(button->integrator == 0)
+		{
+			button->pressed = 0;
+			postEvent(i, BUTTON_RELEASE);
+		}
+		else if(++button->held == _longTicks)
+			postEvent(i, BUTTON_LONG_PRESS);
+		else if(_repeatTicks && button->held >= _longTicks + _repeatTicks)
+		{
+			button->held = _longTicks;
+			postEvent(i, BUTTON_REPEAT);
+		}
+	}
+}
+
+/*************************************************************************************
+ *---------------------------------- RTC Overview -----------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	rtc keeps the nixie time from a DS3231 or DS1307, so it survives power cycles
+ *	and keeps the RTC's accuracy. The RTC is set to give a 1Hz square wave, which
+ *	goes to an external interrupt pin (2 or 3 on an Uno). On each falling edge - when
+ *	the RTC's seconds change - the interrupt just flags that a read is wanted.
+ *
+ *	The reading itself is done by a small TWI state machine moved on by the shared
+ *	tick. Each tick it looks at whether the TWI hardware has finished its last step
+ *	(TWINT), and if so starts the next: start, address, register, repeated start,
+ *	address, then the seconds, minutes and hours. The sketch is never held up
+ *	waiting for the bus, and the new time is passed to nixie::secondTick() once
+ *	all of it has arrived, a step a tick - about 10ms after the edge. make rtc in
+ *	extras/host checks that against a simulated DS3231 and DS1307, along with what
+ *	each tick pays for it.
+ *
+ *	The TWI interrupt isn't used, so the library can be built alongside Wire, but
+ *	Wire mustn't use the bus while the rtc is.
+ *
+ ************************************************************************************/
+
+/*************************************************************************************
+ * Name: 	rtc(nixie *tubes, int sqwPin, uint8_t type)
+ *
+ * Params:	nixie *tubes - the tubes whose time is kept
+ * 			int sqwPin - the pin the square wave output is on, must have an external
+ * 						 interrupt
+ * 			uint8_t type - RTC_DS3231 or RTC_DS1307
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets up the rtc, call begin() to start it.
+ ************************************************************************************/
+rtc::rtc(nixie *tubes, int sqwPin, uint8_t type)
+{
+	_tubes = tubes;
+	_type = type;
+	_interrupt = digitalPinToInterrupt(sqwPin);
+	pinMode(sqwPin, INPUT_PULLUP); //the square wave output is open drain
+}
 
+/* Square wave interrupt lands here */
+static void rtcSecond(void)
+{
+	if(rt != NULL) rt->second();
 }
 
 /*************************************************************************************
- * Name: 	buildLoop(backlight::CycleType_t *node,
- * 					  backlight::CycleType_t *finalNode,
- * 					  uint8_t setup[][4], uint8_t index, uint8_t max)
+ * Name: 	begin(void)
  *
- * Params:	CycleType_t *node		- the working node.
- * 			CycleType_t *finalNode  - used to return the 'final' node
- * 			uint8_t setup[][4]		- the setup array
- * 			uint8_t index			- how far through the array we currently are
- * 			uint8_t max				- what the array maximum is
+ * Params:	None.
  *
- * Returns: Bool - success or failure (failure usually caused by not enough memory).
+ * Returns: None.
  *
- * Desc:	Starts a background colour fade.
+ * Desc:	Starts the TWI bus, turns on the RTC's 1Hz square wave and reads the time.
+ * 			Turn nixie timekeeping off, as the rtc does it instead.
  ************************************************************************************/
-backlight::CycleType_t *backlight::buildLoop(backlight::CycleType_t *node, uint16_t setup[][4], uint8_t index, uint8_t max)
+void rtc::begin(void)
 {
-	/* Populate node cycletype with the colour */
-	for(uint8_t i = 0; i < 3; i++)
-		node->colour[i] = setup[index][i];
+	/* no prescaler */
+	TWSR = 0;
+	TWBR = ((F_CPU / RTC_TWI_HZ) - 16) / 2;
 
-	/*Populate node cycletype with the duration */
-	node->duration = setup[index][3];
+	rt = this;
+	_readPending = 1; //once the square wave is set up
 
-	/* Base case */
-	if(index == max)
+	if(_type == RTC_DS1307)
 	{
-		node->next = NULL;
-		return node;
+		_buffer[0] = 0x07; //control
+		_buffer[1] = 0x10; //SQWE, 1Hz
+	}
+	else
+	{
+		_buffer[0] = 0x0E; //control
+		_buffer[1] = 0x00; //square wave rather than alarm interrupts, 1Hz
 	}
+	start(2, 0);
 
-	/* Create child node */
-	backlight::CycleType_t *next = (backlight::CycleType_t *)malloc(sizeof(backlight::CycleType_t));
-	node->next = next;
+	attachInterrupt(_interrupt, rtcSecond, FALLING);
 
-	/* No memory!! */
-	if(next == NULL)
-		return NULL;
+	/* start the shared tick */
+	TIMSK0 |= (1 << OCIE0A);
+}
 
-	backlight::CycleType_t *toReturn = buildLoop(next, setup, ++index, max);
+/*************************************************************************************
+ * Name: 	setTime(int h, int m, int s)
+ *
+ * Params:	int h - the hours
+ * 			int m - the minutes
+ * 			int s - the seconds
+ *
+ * Returns: Bool - false if the bus is busy, try again shortly.
+ *
+ * Desc:	Sets the time in the RTC and on the tubes. The RTC starts the second
+ * 			again from when it is written.
+ ************************************************************************************/
+bool rtc::setTime(int h, int m, int s)
+{
+	if(_state != RTC_IDLE) return false;
 
-	/* Recursive case */
-	if (NULL != toReturn)
-			return toReturn;
+	_buffer[0] = 0x00; //seconds, then minutes and hours
+	_buffer[1] = ((s / 10) << 4) | (s % 10); //also clears the DS1307 clock halt bit
+	_buffer[2] = ((m / 10) << 4) | (m % 10);
+	_buffer[3] = ((h / 10) << 4) | (h % 10); //24 hour
+	if(!start(4, 0)) return false;
 
-	/* if something failed further down the loop */
-	free((void *)node);
-	return NULL;
+	_tubes->setTime(h, m, s);
+	_tubes->updateTime();
+	return true;
 }
 
 /*************************************************************************************
- * Name: 	freeLoop(backlight::CycleType_t *node,
- * 					 backlight::CycleType_t *endNode)
+ * Name: 	isValid(void)
  *
- * Params:	CycleType_t *node		- the working node.
- * 			CycleType_t *endNode  	- used to return the 'final' node
+ * Params:	None.
  *
- * Returns: None.
+ * Returns: Bool - whether the time has been read from the RTC yet.
  *
- * Desc:	Traverses the loop till the given end node, then returns freeing the
- * 			memory as it goes.
+ * Desc:	Checks whether the time on the tubes has come from the RTC.
  ************************************************************************************/
-void backlight::freeLoop(backlight::CycleType_t *node, backlight::CycleType_t *endNode)
+bool rtc::isValid(void)
 {
-	/* find last part of loop */
-	if(node->next != endNode->next)
-		freeLoop(node->next, endNode);
-
-	/* free up the chain */
-	free((void *) node);
+	return _valid;
+}
 
-	return;
+/*************************************************************************************
+ * Name: 	busy(void)
+ *
+ * Params:	None.
+ *
+ * Returns: Bool - whether the bus is in use.
+ *
+ * Desc:	Checks whether setTime() can be called.
+ ************************************************************************************/
+bool rtc::busy(void)
+{
+	return _state != RTC_IDLE;
 }
 
 /*************************************************************************************
- * Name: 	swapNode(backlight::CycleType_t *node)
+ * Name: 	second(void)
  *
- * Params:	CycleType_t	*node - the current node
+ * Params:	None.
  *
  * Returns: None.
  *
- * Desc:	Swaps one node to the next.
+ * Desc:	Called from the square wave interrupt. Asks for the time to be read.
  ************************************************************************************/
-void backlight::swapNode()
+void rtc::second(void)
 {
-	/* detach and stop timer */
-	TIMSK1 &= ~(1 <<TOIE1);
-
-	/* swap the node */
-	currentNode = currentNode->next;
-
-	/* reset everything */
-	timerSetup();
-	timerCount = 0;
-
-	TIMSK1 |= (1 << TOIE1);
-
-	return;
+	_readPending = 1;
 }
 
 /*************************************************************************************
- * Name: 	timerSetup(void)
+ * Name: 	tick(void)
  *
  * Params:	None.
  *
  * Returns: None.
  *
- * Desc:	Configures the timer for the current node.
+ * Desc:	Called from the shared tick. Moves the bus on a step if it is ready, or
+ * 			starts a read if one is wanted.
  ************************************************************************************/
-void backlight::timerSetup(void)
+void rtc::tick(void)
 {
-	/* Reset timer 1 control registers */
-	TCCR1A = 0;
-	TCCR1B = 0;
-
-	uint32_t usCycleTime = currentNode->duration; //must be done in 2 steps to prevent 16 bit int overflow
-	usCycleTime *= 1000;
-	uint32_t usTickTime = usCycleTime / FADE_RESOLUTION; // div 256
-	uint16_t preload;
+	if(_state != RTC_IDLE)
+	{
+		if(TWCR & (1 << TWINT)) step();
+	}
+	else if(_readPending)
+	{
+		_buffer[0] = 0x00; //from the seconds
+		if(start(1, 3)) _readPending = 0;
+	}
+}
 
-	/* Work out prescaler and preload val */
-	if 	(usTickTime < 0x00007FFF) { //2MHz
-		/* Period is 0.5us */
-		preload = usTickTime << 1;
-		TCCR1B |= (1 << CS11);
-	} else if (usTickTime < 0x0003FFFF) { //250KHz
-		/* Period is 4us */
-		preload = usTickTime >> 2;
-		TCCR1B |= (1 << CS10 | 1 << CS11);
-	} else if (usTickTime < 0x000FFFFF) { //62.5KHz
-		/* Period is 16us */
-		preload = usTickTime >> 4;
-		TCCR1B |= (1 << CS12);
-	} else { //15.625KHz
-		/* Period is 64us */
-		preload = usTickTime >> 6;
-		TCCR1B |= (1 << CS10 | 1 << CS12);
+/*************************************************************************************
+ * Name: 	start(uint8_t writeLength, uint8_t readLength)
+ *
+ * Params:	uint8_t writeLength - bytes of _buffer to write, starting with the register
+ * 			uint8_t readLength - bytes to read into _buffer after
+ *
+ * Returns: Bool - false if the bus is busy.
+ *
+ * Desc:	Starts a transfer with the RTC.
+ ************************************************************************************/
+bool rtc::start(uint8_t writeLength, uint8_t readLength)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	if(_state != RTC_IDLE || (TWCR & (1 << TWSTO))) //busy, or the last stop is still going out
+	{
+		SREG = oldSREG;
+		return false;
 	}
+	_state = RTC_START;
+	SREG = oldSREG;
 
-	TIM1Preload = (uint16_t)(0xFFFF - preload);
+	_writeLength = writeLength;
+	_readLength = readLength;
+	_index = 0;
+	twi_go(1 << TWSTA);
+	return true;
 }
 
 /*************************************************************************************
- * Name: 	isr()
+ * Name: 	step(void)
  *
  * Params:	None.
  *
  * Returns: None.
  *
- * Desc:	This is the ISR routine. Updates the colours on the backlight and checks
- * 			the arrayIndex.
+ * Desc:	Moves the transfer on once the TWI hardware has finished the last step.
  ************************************************************************************/
-void backlight::isr()
+void rtc::step(void)
 {
-	/* Preload the timer again - done here to increase timing accuracy */
-	load_timer1_count(TIM1Preload);
-
-	/* Reckon this will be quicker but not sure */
-	uint8_t current[3], aim[3], disp[3];
-	memcpy((void *)current, (void *)currentNode->colour, 		3*sizeof(uint8_t));
-	memcpy((void *)aim, 	(void *)currentNode->next->colour, 	3*sizeof(uint8_t));
+	switch(TWSR & 0xF8)
+	{
+		case 0x08: //start sent
+			TWDR = RTC_ADDRESS << 1; //write
+			twi_go(0);
+			_state = RTC_WRITE;
+			break;
 
-	/* Read the current cos fade value */
-	uint16_t wordFromProgMem = pgm_read_word_near(cosFade + timerCount);
-	float factor = (float)(wordFromProgMem) / 65535;
+		case 0x10: //repeated start sent
+			TWDR = (RTC_ADDRESS << 1) | 1; //read
+			twi_go(0);
+			_state = RTC_READ;
+			_index = 0;
+			break;
 
-	/* Work out the new colours */
-	for(uint8_t j = 0; j < 3; j++)
-		disp[j]= current[j] + uint8_t(factor*(float)(aim[j] - 	current[j]));
+		case 0x18: //address acknowledged
+		case 0x28: //byte acknowledged
+			if(_index < _writeLength)
+			{
+				TWDR = _buffer[_index++];
+				twi_go(0);
+			}
+			else if(_readLength)
+				twi_go(1 << TWSTA);
+			else
+				finish(1);
+			break;
 
-	/* Apply them */
-	updateAnalogPin(_pins[0], 255-disp[0]);
-	updateAnalogPin(_pins[1], 255-disp[1]);
-	updateAnalogPin(_pins[2], 255-disp[2]);
+		case 0x40: //read address acknowledged
+			twi_go(_readLength > 1 ? (1 << TWEA) : 0);
+			break;
 
-	/* Again reckon this will be quicker but a straightforward assignment may have to do */
-	memcpy((void *)currentFadeColour, (void *)disp, 3*sizeof(uint8_t));
+		case 0x50: //byte received, more to come
+			_buffer[_index++] = TWDR;
+			twi_go(_index < _readLength - 1 ? (1 << TWEA) : 0);
+			break;
 
-	/* if we need to swap nodes */
-	if(++timerCount >= FADE_RESOLUTION)
-		swapNode();
+		case 0x58: //last byte received
+			_buffer[_index++] = TWDR;
+			finish(1);
+			break;
 
+		default: //not acknowledged or lost the bus
+			finish(0);
+			break;
+	}
 }
 
 /*************************************************************************************
- * Name: 	stopFade(int stopColour[3], int duration)
+ * Name: 	finish(bool ok)
  *
- * Params:	int stopColour[3] - the colour to fade to once stopped.
- * 			int duration - how long the fade should last.
+ * Params:	bool ok - whether the transfer worked
  *
  * Returns: None.
  *
- * Desc:	Stops the fade. Detaches the ISR and fades to the colour specified.
+ * Desc:	Ends the transfer, and passes on the time if it was a read.
  ************************************************************************************/
-void backlight::stopFade(int stopColour[3], int duration)
+void rtc::finish(bool ok)
 {
-	/* detach and stop the ISR */
-	TIMSK1 &= ~(1 << TOIE1);
-	TCCR1B &= 0x00;
+	twi_go(1 << TWSTO);
+	_state = RTC_IDLE;
 
-	/* free the memory in the loop */
-	freeLoop(entry->next, entry);
+	if(!_readLength) return;
+	if(!ok)
+	{
+		_readPending = 1; //try again on the next tick
+		return;
+	}
 
-	/* free the entry point */
-	free((void *)entry);
+	uint8_t s = ((_buffer[0] >> 4) & 0x07) * 10 + (_buffer[0] & 0x0F);
+	uint8_t m = (_buffer[1] >> 4) * 10 + (_buffer[1] & 0x0F);
+	uint8_t h = ((_buffer[2] >> 4) & 0x03) * 10 + (_buffer[2] & 0x0F);
+	_valid = 1;
+	_tubes->secondTick(h, m, s);
+}
 
-	/* Can't use memcpy as int is 16-bit */
-	int tempColour[3] = { currentFadeColour[0], currentFadeColour[1], currentFadeColour[2] };
-	int tempStopColour[3] = { stopColour[0], stopColour[1], stopColour[2] };
+/*************************************************************************************
+ *-------------------------------- Remote Overview ----------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	remote lets a host drive the tubes and backlight over a serial port. Bytes are
+ *	taken in by the port's own receive interrupt and buffer (Serial, or any other
+ *	Stream), and update() - called from loop() - passes whatever has arrived through
+ *	a parser one byte at a time, so a half received command just waits for the rest.
+ *	Nothing is allocated; commands are built up in _buffer. Bytes from elsewhere can
+ *	be given to feed() directly.
+ *
+ *	Text commands are a letter and its arguments, ended by a new line, and answered
+ *	with OK or ERR:
+ *
+ *		D123456			- digits, anything other than 0-9 is a blank tube
+ *		N-12.5			- a number, through display()
+ *		P010100			- decimal points, 1 for on, shown with the next digits
+ *		S4,17			- a symbol, tube then symbol, shown with the next digits
+ *		T12:34:56		- the time, through setTime() and updateTime()
+ *		C255,0,100		- backlight colour
+ *		F1000,255,0,0,500,0,0,255,500
+ *						- fade, the fade in time then r,g,b,duration for each step
+ *		X0,0,0,1000		- stop the fade, fading to r,g,b over the duration, which
+ *						  can't be negative
+ *
+ *	Binary commands start with a byte from 0x80 up, which can't start a text
+ *	command, and are laid out as:
+ *
+ *		{ Command, Length, Payload_0, ... Payload_(Length-1), Check }
+ *
+ *	where Check is the XOR of all the bytes before it. They are answered with
+ *	REMOTE_ACK (0x06), or REMOTE_NAK (0x15) if the check fails or the command can't
+ *	be run:
+ *
+ *		REMOTE_DIGITS	- 6 digits
+ *		REMOTE_FRAME	- a Frame_t without its dwell, 6 tube words (low byte first)
+ *						  then the decimal point byte
+ *		REMOTE_POINTS	- 1 byte, bit n for the decimal point on tube n
+ *		REMOTE_SYMBOL	- tube, symbol
+ *		REMOTE_TIME		- hours, minutes, seconds
+ *		REMOTE_COLOUR	- r, g, b
+ *		REMOTE_FADE		- fade in time (2 bytes) then r, g, b, duration (2 bytes)
+ *						  for each step
+ *		REMOTE_STOP		- r, g, b, duration (2 bytes, no more than 0x7FFF)
+ *
+ ************************************************************************************/
 
-	/* fade to stop colour */
-	crossFade(tempColour, tempStopColour, duration);
+/*************************************************************************************
+ * Name: 	remote(Stream *port, nixie *tubes, backlight *rgb)
+ *
+ * Params:	Stream *port - where the commands come from, e.g. &Serial
+ * 			nixie *tubes - the tubes to control
+ * 			backlight *rgb - the backlight to control, or NULL
+ *
+ * Returns: None.
+ *
+ * Desc:	Sets up a command endpoint. The port must already be started.
+ ************************************************************************************/
+remote::remote(Stream *port, nixie *tubes, backlight *rgb)
+{
+	_port = port;
+	_tubes = tubes;
+	_rgb = rgb;
 }
 
 /*************************************************************************************
- * Name: 	updateAnalogPin(volatile uint8_t pin, uint8_t val)
+ * Name: 	update(void)
  *
- * Params:	uint8_t pin - the pin to update.
- * 			uint8_t value - the new value.
+ * Params:	None.
  *
  * Returns: None.
  *
- * Desc:	This updates the Capture/Compare register for the PWM pins, but does not
- * 			affect the state of the timers (unlike AnalogWrite). The PWM timers must
- * 			be running before this function is used, otherwise it will do nothing.
+ * Desc:	Runs any commands that have arrived. Call this from loop().
  ************************************************************************************/
-void backlight::updateAnalogPin(volatile uint8_t pin, uint8_t val)
+void remote::update(void)
 {
-	
-	switch(digitalPinToTimer(pin))
+	while(_port->available() > 0)
+		feed(_port->read());
+}
+
+/*************************************************************************************
+ * Name: 	feed(uint8_t c)
+ *
+ * Params:	uint8_t c - the next byte received
+ *
+ * Returns: None.
+ *
+ * Desc:	Moves the parser on by a byte, running the command once it is complete.
+ ************************************************************************************/
+void remote::feed(uint8_t c)
+{
+	switch(_state)
 	{
-		#if defined(TCCR0) && defined(COM00) && !defined(__AVR_ATmega8__)
-		case TIMER0A:
-			OCR0 = val; // set pwm duty
+		case REMOTE_IDLE:
+			if(c & 0x80)
+			{
+				_command = c;
+				_check = c;
+				_state = REMOTE_LENGTH;
+			}
+			else if(c >= 'A')
+			{
+				_buffer[0] = c;
+				_count = 1;
+				_state = REMOTE_TEXT;
+			}
+			break; //anything else, like the rest of a \r\n, is ignored
+
+		case REMOTE_TEXT:
+			if(c == '\n' || c == '\r')
+			{
+				_buffer[_count] = '\0';
+				_port->println(runText() ? "OK" : "ERR");
+				_state = REMOTE_IDLE;
+			}
+			else if(_count < REMOTE_BUFFER_SIZE)
+				_buffer[_count++] = c;
+			else
+				_state = REMOTE_SKIP;
 			break;
-		#endif
 
-		#if defined(TCCR0A) && defined(COM0A1)
-		case TIMER0A:
-			OCR0A = val; // set pwm duty
+		case REMOTE_SKIP:
+			if(c == '\n' || c == '\r')
+			{
+				_port->println("ERR");
+				_state = REMOTE_IDLE;
+			}
 			break;
-		#endif
 
-		#if defined(TCCR0A) && defined(COM0B1)
-		case TIMER0B:
-			OCR0B = val; // set pwm duty
+		case REMOTE_LENGTH:
+			_check ^= c;
+			_length = c;
+			_count = 0;
+			_state = (c == 0) ? REMOTE_CHECK : REMOTE_PAYLOAD;
 			break;
-		#endif
 
-		/*#if defined(TCCR1A) && defined(COM1A1)
-		case TIMER1A:
+		case REMOTE_PAYLOAD:
+			_check ^= c;
+			if(_count < REMOTE_BUFFER_SIZE) _buffer[_count] = c;
+			if(++_count == _length) _state = REMOTE_CHECK;
 			break;
-		#endif
 
-		#if defined(TCCR1A) && defined(COM1B1)
-		case TIMER1B:
+		case REMOTE_CHECK:
+			_port->write((c == _check && _length <= REMOTE_BUFFER_SIZE && runBinary()) ? REMOTE_ACK : REMOTE_NAK);
+			_state = REMOTE_IDLE;
 			break;
-		#endif
+	}
+}
 
-		#if defined(TCCR1A) && defined(COM1C1)
-		case TIMER1C:
-			break;
-		#endif*/
+/*************************************************************************************
+ * Name: 	runText(void)
+ *
+ * Params:	None.
+ *
+ * Returns: Bool - false if the command wasn't understood.
+ *
+ * Desc:	Runs the text command in _buffer.
+ ************************************************************************************/
+bool remote::runText(void)
+{
+	const char *args = &_buffer[1];
+	int values[REMOTE_FADE_STEPS * 4 + 1];
+	uint8_t count = parseInts(args, values, REMOTE_FADE_STEPS * 4 + 1);
 
-		#if defined(TCCR2) && defined(COM21)
-		case TIMER2:
-			OCR2 = val; // set pwm duty
-			break;
-		#endif
+	switch(_buffer[0])
+	{
+		case 'D':
+		{
+			uint8_t digits[6];
+			for(uint8_t i = 0; i < 6; i++)
+				digits[i] = (i < _count - 1 && args[i] >= '0' && args[i] <= '9') ? args[i] - '0' : BLANK;
+			_tubes->displayDigits(digits);
+			return true;
+		}
 
-		#if defined(TCCR2A) && defined(COM2A1)
-		case TIMER2A:
-			OCR2A = val; // set pwm duty
-			break;
-		#endif
+		case 'N':
+			if(strchr(args, '.') != NULL)
+				_tubes->display((float)atof(args));
+			else
+				_tubes->display(atol(args));
+			return true;
+
+		case 'P':
+			for(uint8_t i = 0; i < 6; i++)
+				_tubes->setDecimalPoint(i, i < _count - 1 && args[i] == '1');
+			return true;
+
+		case 'S':
+			if(count != 2) return false;
+			_tubes->setSymbol(values[0], values[1]);
+			return true;
+
+		case 'T':
+			if(_count < 9) return false;
+			_tubes->setTime(_buffer + 1);
+			_tubes->updateTime();
+			return true;
+
+		case 'C':
+			if(count != 3 || _rgb == NULL) return false;
+			_rgb->setColour(values);
+			return true;
+
+		case 'F':
+			if(count < 5 || (count - 1) % 4) return false;
+			return runFade(values, count);
+
+		case 'X':
+			if(count != 4 || values[3] < 0 || _rgb == NULL) return false;
+			_rgb->stopFade(values, values[3]);
+			return true;
 
-		#if defined(TCCR2A) && defined(COM2B1)
-		case TIMER2B:
-			OCR2B = val; // set pwm duty
-			break;
-		#endif
+		default:
+			return false;
+	}
+}
 
-		#if defined(TCCR3A) && defined(COM3A1)
-		case TIMER3A:
-			OCR3A = val; // set pwm duty
-			break;
-		#endif
+/*************************************************************************************
+ * Name: 	runBinary(void)
+ *
+ * Params:	None.
+ *
+ * Returns: Bool - false if the command wasn't understood.
+ *
+ * Desc:	Runs the binary command _command, with its payload in _buffer.
+ ************************************************************************************/
+bool remote::runBinary(void)
+{
+	uint8_t *payload = (uint8_t *)_buffer;
+	int values[REMOTE_FADE_STEPS * 4 + 1];
 
-		#if defined(TCCR3A) && defined(COM3B1)
-		case TIMER3B:
-			OCR3B = val; // set pwm duty
-			break;
-		#endif
+	switch(_command)
+	{
+		case REMOTE_DIGITS:
+			if(_length != 6) return false;
+			_tubes->displayDigits(payload);
+			return true;
 
-		#if defined(TCCR3A) && defined(COM3C1)
-		case TIMER3C:
-			OCR3C = val; // set pwm duty
-			break;
-		#endif
+		case REMOTE_FRAME:
+		{
+			if(_length != 13) return false;
+			nixie::Frame_t frame;
+			for(uint8_t i = 0; i < 6; i++)
+				frame.tube[i] = payload[2 * i] | (payload[2 * i + 1] << 8);
+			frame.decimalPoints = payload[12];
+			_tubes->displayFrame(&frame);
+			return true;
+		}
 
-		#if defined(TCCR4A)
-		case TIMER4A:
-			OCR4A = val;	// set pwm duty
-			break;
-		#endif
-		
-		#if defined(TCCR4A) && defined(COM4B1)
-		case TIMER4B:
-			OCR4B = val; // set pwm duty
-			break;
-		#endif
+		case REMOTE_POINTS:
+			if(_length != 1) return false;
+			for(uint8_t i = 0; i < 6; i++)
+				_tubes->setDecimalPoint(i, payload[0] & (1 << i));
+			return true;
+
+		case REMOTE_SYMBOL:
+			if(_length != 2) return false;
+			_tubes->setSymbol(payload[0], payload[1]);
+			return true;
+
+		case REMOTE_TIME:
+			if(_length != 3) return false;
+			_tubes->setTime(payload[0], payload[1], payload[2]);
+			_tubes->updateTime();
+			return true;
+
+		case REMOTE_COLOUR:
+			if(_length != 3 || _rgb == NULL) return false;
+			for(uint8_t i = 0; i < 3; i++)
+				values[i] = payload[i];
+			_rgb->setColour(values);
+			return true;
+
+		case REMOTE_FADE:
+		{
+			if(_length < 7 || (_length - 2) % 5 || (_length - 2) / 5 > REMOTE_FADE_STEPS) return false;
+			uint8_t count = 1;
+			values[0] = payload[0] | (payload[1] << 8);
+			for(uint8_t i = 2; i < _length && count < REMOTE_FADE_STEPS * 4 + 1; i += 5)
+			{
+				values[count++] = payload[i];
+				values[count++] = payload[i + 1];
+				values[count++] = payload[i + 2];
+				values[count++] = payload[i + 3] | (payload[i + 4] << 8);
+			}
+			return runFade(values, count);
+		}
 
-		#if defined(TCCR4A) && defined(COM4C1)
-		case TIMER4C:
-			OCR4C = val; // set pwm duty
-			break;
-		#endif
-			
-		#if defined(TCCR4C) && defined(COM4D1)
-		case TIMER4D:				
-			OCR4D = val;	// set pwm duty
-			break;
-		#endif
+		case REMOTE_STOP:
+		{
+			if(_length != 5 || _rgb == NULL) return false;
+			uint16_t duration = payload[3] | (payload[4] << 8);
+			if(duration > 0x7FFF) return false; //stopFade() takes an int, and negative ones never finish
+			for(uint8_t i = 0; i < 3; i++)
+				values[i] = payload[i];
+			_rgb->stopFade(values, duration);
+			return true;
+		}
 
-						
-		#if defined(TCCR5A) && defined(COM5A1)
-		case TIMER5A:
-			OCR5A = val; // set pwm duty
-			break;
-		#endif
+		default:
+			return false;
+	}
+}
 
-		#if defined(TCCR5A) && defined(COM5B1)
-		case TIMER5B:
-			OCR5B = val; // set pwm duty
-			break;
-		#endif
+/*************************************************************************************
+ * Name: 	runFade(int values[], uint8_t count)
+ *
+ * Params:	int values[] - the fade in time, then r,g,b,duration for each step
+ * 			uint8_t count - the number of values
+ *
+ * Returns: Bool - false if there is no backlight, too many steps, or not enough
+ * 			memory for the fade.
+ *
+ * Desc:	Starts a fade sent to the remote.
+ ************************************************************************************/
+bool remote::runFade(int values[], uint8_t count)
+{
+	if(_rgb == NULL) return false;
 
-		#if defined(TCCR5A) && defined(COM5C1)
-		case TIMER5C:
-			OCR5C = val; // set pwm duty
-			break;
-		#endif
+	uint8_t steps = (count - 1) / 4;
+	if(steps > REMOTE_FADE_STEPS) return false;
 
-		case NOT_ON_TIMER:
-			break;
-		default:
-			break;
+	int setup[REMOTE_FADE_STEPS + 1][4];
+	for(uint8_t i = 0; i < steps; i++)
+	{
+		for(uint8_t j = 0; j < 4; j++)
+			setup[i][j] = values[1 + 4 * i + j];
+		if(setup[i][3] == 0) return false; //would end the cycle early
+	}
+	for(uint8_t j = 0; j < 4; j++)
+		setup[steps][j] = 0; //ENDCYCLE
+
+	return _rgb->setFade(setup, values[0]);
+}
+
+/*************************************************************************************
+ * Name: 	parseInts(const char *text, int values[], uint8_t max)
+ *
+ * Params:	const char *text - numbers separated by anything that isn't part of one
+ * 			int values[] - filled with the numbers
+ * 			uint8_t max - the most numbers to read
+ *
+ * Returns: uint8_t - the number of numbers found, max + 1 if there were more.
+ *
+ * Desc:	Reads a list of whole numbers.
+ ************************************************************************************/
+uint8_t remote::parseInts(const char *text, int values[], uint8_t max)
+{
+	uint8_t count = 0;
+	while(*text)
+	{
+		if((*text >= '0' && *text <= '9') || (*text == '-' && text[1] >= '0' && text[1] <= '9'))
+		{
+			if(count == max) return max + 1;
+			char *end;
+			values[count++] = strtol(text, &end, 10);
+			text = end;
+		}
+		else
+			text++;
 	}
+	return count;
+}
+
+/*************************************************************************************
+ *---------------------------- Shared Tick Overview ---------------------------------*
+ *-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*
+ *
+ *	TIMER1 belongs to the colour fading, so work that has to happen in the background
+ *	on the nixie side uses the TIMER0 compare A interrupt instead. TIMER0 is already
+ *	running for millis() and the PWM pins, and the compare match happens once every
+ *	time the counter goes round whatever OCR0A is set to, so this gives a tick at
+ *	the same rate as millis() without changing the timer or the PWM output on OCR0A.
+ *
+ *	The tick is turned on the first time something needs it.
+ *
+ *	Keep what runs on the tick short - it runs with interrupts off. So it never
+ *	shifts a frame out itself: the frame queue, scrolling, the clock, the time
+ *	editor and the stopwatch build their frame and leave it with postFrame(), and
+ *	update() from loop() does the shift of about 1ms with interrupts on. A tick
+ *	takes a few us, and the fades aren't held up by the tubes.
+ *
+ *	To check the timing on real hardware, define TICK_TRACE_PIN and FADE_TRACE_PIN
+ *	in NixieDriver.h. Each pin is high for as long as its interrupt runs, so a logic
+ *	analyser shows the period and jitter of each, and how long they take, next to
+ *	the driver's own pins - output enable low is the dark time of each frame in
+ *	shift(), and the clock pin shows the bit rate of transmit().
+ *
+ *	The same figures are checked off hardware by `make trace` in extras/host, which
+ *	runs the stopwatch over a colour cycle on the simulator, fails if a frame is
+ *	dark for over 1ms or either interrupt is held off by more than the other one
+ *	takes, and saves a VCD of the pins and interrupts to build/trace.vcd.
+ *
+ ************************************************************************************/
+
+/* Shared tick lands here */
+ISR(TIMER0_COMPA_vect)
+{
+	tick_trace(HIGH);
+	if(nx != NULL) nx->tick();
+	if(bt != NULL) bt->tick();
+	if(rt != NULL) rt->tick();
+	tick_trace(LOW);
 }
 
 /* ISR Vector lands here - calls backlight function to access private functions */
-ISR(TIMER1_OVF_vect)
+ISR(TIMER1_COMPA_vect)
 {
+	fade_trace(HIGH);
 	bl->isr();
+	fade_trace(LOW);
 }
@@ -27,6 +27,8 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
+#include <Stream.h>
+
 #ifndef NixieDriver_h
 #define NixieDriver_h
 
@@ -63,6 +65,41 @@
 
 #define RESOLUTION 65536    // Timer1 is 16 bit
 
+/* Steps per fade, a power of 2 from 8 to 4096. The library is compiled on its own,
+ * so this can only be changed by editing it here - defining it in a sketch would
+ * give the sketch and the library tables of different sizes. */
+#define FADE_RESOLUTION 256
+
+/* Define either as a spare pin (here, or with -D) to have it held high while that
+ * interrupt runs, so its period and length can be measured on a logic analyser */
+//#define FADE_TRACE_PIN 12	// the fade interrupt on TIMER1
+//#define TICK_TRACE_PIN 13	// the shared tick on TIMER0
+
+#define CURVE_COSINE 0
+#define CURVE_LINEAR 1
+#define CURVE_QUADRATIC 2
+#define CURVE_EXPONENTIAL 3
+#define CURVE_PERCEPTUAL 4
+
+#define EASE_COSINE FadeCurve<CURVE_COSINE>::table
+#define EASE_LINEAR FadeCurve<CURVE_LINEAR>::table
+#define EASE_QUADRATIC FadeCurve<CURVE_QUADRATIC>::table
+#define EASE_EXPONENTIAL FadeCurve<CURVE_EXPONENTIAL>::table
+#define EASE_PERCEPTUAL FadeCurve<CURVE_PERCEPTUAL>::table
+
+#define GAMMA(tenths, scale) GammaTable<tenths, scale>::table	// i.e. GAMMA(22, 255) for 2.2
+
+#define FRAME_QUEUE_SIZE 4				// frames waiting to be shown, must be a power of 2
+#define SCROLL_BUFFER_SIZE 32			// digits waiting to scroll on, must be a power of 2
+
+#define USAGE_EEPROM_ADDRESS 0			// first byte of the cathode usage log
+#define USAGE_SLOTS 4					// copies of the log rotated through on each flush
+#define USAGE_FLUSH_INTERVAL 3600000UL	// ms between flushes of the usage log
+
+#define CONFIG_EEPROM_ADDRESS 512		// first byte of the saved configuration, after the usage log
+#define CONFIG_SLOTS 2					// copies of the configuration written in turn
+#define CONFIG_FADE_STEPS 8				// most fade steps saved with the configuration
+
 #define BLACK 0,0,0 
 #define WHITE 255,255,255
 #define RED 255,0,0
@@ -74,11 +111,121 @@
 #define MAGENTA 255,0,100
 #define PURPLE 190,0,255
 #define ENDCYCLE 0,0,0,0
+#define HSV(h, s, v) ((h) | 0x100),(s),(v)	// hue, saturation, value in place of r,g,b
+
+#define FADE_RGB 0
+#define FADE_HSV 1
+
+#define FADE_EVENT_QUEUE_SIZE 8			// fade events waiting for update(), must be a power of 2
+
+#define ON_SEGMENT 0		// a fade step has started, passed the step number
+#define ON_CYCLE 1			// the fade has gone back round to the first step
+#define ON_FADE_DONE 2		// crossFade(), fadeIn() or fadeOut() has finished
+#define FADE_EVENTS 3
+
+#define FADE_IN_STEP 0xFF	// step number given for the fade in to setFade()
+
+#define SYNC_OFF 0			// fade durations in ms
+#define SYNC_SECONDS 1		// fade durations in seconds of the clock
+#define SYNC_MINUTES 2		// fade durations in minutes of the clock
+#define SYNC_HOURS 3		// fade durations in hours of the clock
+
+#define PWM_8BIT 0			// analogWrite resolution
+#define PWM_HIGHRES 1		// 16 bit timers where the pin has one, dithered 8 bit elsewhere
+
+#define FIELD_NONE 0		// not editing the time
+#define FIELD_HOURS 1
+#define FIELD_MINUTES 2
+#define FIELD_SECONDS 3
+
+#define EDIT_UP 1			// keys for editTime()
+#define EDIT_DOWN 2
+#define EDIT_SELECT 3
+
+#define STOPWATCH_OFF 0		// modes of the stopwatch
+#define STOPWATCH_UP 1
+#define STOPWATCH_DOWN 2
+
+#define STOPWATCH_LAPS 8	// most laps remembered by lapStopwatch()
+
+#define BUTTON_COUNT 4					// most buttons one set can read
+#define BUTTON_QUEUE_SIZE 8				// button events waiting to be read, must be a power of 2
+#define NO_BUTTON -1
+
+#define BUTTON_PRESS 1			// debounced press
+#define BUTTON_LONG_PRESS 2		// held for the long press time
+#define BUTTON_REPEAT 3			// still held, every repeat time after the long press
+#define BUTTON_RELEASE 4		// let go
+
+#define RTC_DS3231 0
+#define RTC_DS1307 1
+
+#define REMOTE_BUFFER_SIZE 64			// longest command line or binary payload
+#define REMOTE_FADE_STEPS 8				// most steps in a fade sent to remote
+
+#define REMOTE_DIGITS 0x81		// binary commands, see the Remote Overview
+#define REMOTE_FRAME 0x82
+#define REMOTE_POINTS 0x83
+#define REMOTE_SYMBOL 0x84
+#define REMOTE_TIME 0x85
+#define REMOTE_COLOUR 0x86
+#define REMOTE_FADE 0x87
+#define REMOTE_STOP 0x88
+
+/* Builds the cathode table of a board profile from the output bit of each digit */
+#define CATHODE_MAP(d0, d1, d2, d3, d4, d5, d6, d7, d8, d9) \
+		{ 1u << (d0), 1u << (d1), 1u << (d2), 1u << (d3), 1u << (d4), \
+		  1u << (d5), 1u << (d6), 1u << (d7), 1u << (d8), 1u << (d9) }
+
+class backlight;
 
 class nixie
 {
+	public:
+
+		/* Describes how a board is wired - must be stored in PROGMEM */
+		struct BoardProfile_t {
+			uint16_t cathode[10];		//output bits to set for digits 0-9
+			uint8_t tube[6];			//position in the chain of each tube, 0 = last shifted
+			uint8_t decimalPoint[6];	//bit of the decimal point byte for each tube
+		};
+
+		/* A frame ready to be shifted out, as built by encodeFrame() */
+		struct Frame_t {
+			uint16_t tube[6];			//output bits, in chain order
+			uint8_t decimalPoints;		//decimal point byte
+			uint16_t dwell;				//ms to show the frame for when queued
+		};
+
+		/* Called from update() when a countdown reaches zero */
+		typedef void (*AlarmCallback_t)(void);
+
 	private:
 
+		struct UsageType_t {
+			uint16_t seconds[6][10];	//lit time not yet written to EEPROM
+			uint16_t residual[6];		//ms carried towards the next second
+			uint32_t lastFlush;
+			uint16_t flushWord;
+			uint8_t flushStep;
+			uint8_t slot;
+			uint8_t seq;
+		};
+
+		struct ConfigType_t {
+			uint8_t flags;				//clock mode, timekeeping, fading
+			uint8_t symbolMask[6];
+			uint8_t symbols[6];
+			uint16_t dpMask;
+			uint8_t time[3];			//h, m, s
+			uint16_t frame[6];			//the tubes as last shown, for anything but the clock
+			uint8_t framePoints;		//and their decimal points
+			uint8_t colour[3];			//backlight colour when not fading
+			uint8_t fadeSteps;
+			int fade[CONFIG_FADE_STEPS][4];
+			uint8_t fadeCurves[CONFIG_FADE_STEPS];	//CURVE_ of each step
+		};
+
 		uint8_t _dataPin;
 		uint8_t _clockPin;
 		uint8_t _outputEnablePin;
@@ -88,24 +235,85 @@ class nixie
 		uint8_t _symbolMask[6] = {0,0,0,0,0,0};
 		uint8_t _symbols[6] = {BLANK,BLANK,BLANK,BLANK,BLANK,BLANK};
 		uint8_t _symbolDivisor = 1;
+		uint16_t _frame[6] = {0,0,0,0,0,0};
+		uint8_t _framePoints = 0;
+		uint16_t _dueFrame[6];			//left by the shared tick for update() to shift out
+		uint8_t _duePoints;
+		volatile bool _frameDue = 0;
+		volatile bool _lit = 0;
+		UsageType_t *_usage = NULL;
+		const BoardProfile_t *_profile;
+		Frame_t _frameQueue[FRAME_QUEUE_SIZE];
+		volatile uint8_t _frameHead = 0;
+		volatile uint8_t _frameCount = 0;
+		volatile uint16_t _frameDwell = 0;
+		uint16_t _tickFraction = 0;
+		uint8_t _scrollBuffer[SCROLL_BUFFER_SIZE];
+		uint8_t _scrollWindow[6];
+		volatile uint8_t _scrollHead = 0;
+		volatile uint8_t _scrollCount = 0;
+		volatile uint8_t _scrollTrail = 0;
+		uint16_t _scrollSpeed = 250;
+		uint16_t _scrollTimer = 0;
+		bool _timekeeping = 0;
+		volatile bool _timeSynced = 0;	//set by the sketch or an RTC, not a restored config
+		uint16_t _clockMs = 0;
+		volatile uint8_t _editField = FIELD_NONE;
+		bool _editBlink = 0;
+		uint16_t _editTimer = 0;
+		volatile uint8_t _watchMode = STOPWATCH_OFF;
+		volatile bool _watchPaused = 0;
+		uint8_t _watch[8];				//h, h, m, m, s, s, 1/10, 1/100 as BCD digits
+		uint8_t _watchMs = 0;
+		uint8_t _watchWindow = 2;		//first digit of _watch on the tubes
+		uint16_t _watchFrame[6];
+		uint8_t _watchPoints;			//decimal points of _watchFrame
+		uint32_t _watchStart = 0;
+		uint32_t _laps[STOPWATCH_LAPS];
+		volatile uint8_t _lapCount = 0;
+		volatile bool _alarmDue = 0;
+		AlarmCallback_t _alarmCallback = NULL;
 
 		//static nixie *activate_object;
 		void transmit(bool data);
 		void shift(uint16_t data[]);
+		void shift(const uint16_t data[], uint8_t decimalPoints);
 		void setDataPin(uint8_t data);
 		void setClk(uint8_t clk);
 		void setOE(uint8_t oe);
 		void setSrb(uint8_t srb);
 		void disp(uint32_t num);
+		bool displayNumber(uint32_t magnitude, uint8_t base, uint8_t sign);
+		void encode(const uint8_t digits[], uint16_t data[]);
+		void postFrame(const uint16_t data[], uint8_t decimalPoints);
+		void showDue(void);
+		bool postTime(void);
+		bool pushGlyph(uint8_t glyph);
+		void scrollStep(void);
 		void startupTransmission(void);
+		void accountUsage(uint8_t elapsed);
+		void usageFlushStep(void);
+		uint16_t *usageSlotWord(uint8_t slot, uint8_t index);
+		uint8_t advanceClock(void);
+		void showEdit(void);
+		void passSecond(uint8_t unit);
+		uint8_t *configSlot(uint8_t slot);
+		uint16_t configCrc(uint8_t slot);
+		int8_t newestConfig(void);
+		void startWatch(uint8_t mode);
+		int8_t stepWatch(void);
+		void showWatch(int8_t from);
+		uint32_t packWatch(void);
+		uint32_t watchHundredths(uint32_t bcd);
 
 
 	public:
 	
+		static const BoardProfile_t doayeeBoard;
 		
-		volatile long hours;
-		volatile long minutes;
-		volatile long seconds;
+		volatile uint8_t hours;
+		volatile uint8_t minutes;
+		volatile uint8_t seconds;
 		
 		nixie(int data, int clk, int oe, int srb);
 		nixie(int data, int clk, int oe);
@@ -113,6 +321,17 @@ class nixie
 		~nixie();
 		
 		void displayDigits(int a, int b, int c, int d, int e, int f);
+		void displayDigits(const uint8_t digits[]);
+		void encodeFrame(const uint8_t digits[], Frame_t *frame);
+		void displayFrame(const Frame_t *frame);
+		uint8_t queueFrames(const Frame_t frames[], uint8_t count);
+		uint8_t framesQueued(void);
+		void clearFrames(void);
+		uint8_t scroll(const char *text);
+		bool scrollSymbol(int symbol, bool dp);
+		void setScrollSpeed(uint16_t ms);
+		uint8_t scrollSpace(void);
+		void clearScroll(void);
 		void display(float num);
 		void display(long num);
 		void display(int num);
@@ -125,51 +344,331 @@ class nixie
 		void setMinutes(int m);
 		void setSeconds(int s);
 		bool updateTime(void);
+		void setTimekeeping(bool state);
+		void secondTick(int h, int m, int s);
+		bool isTimeSynced(void);
+		void startTimeEdit(void);
+		bool editTime(uint8_t key);
+		uint8_t getEditField(void);
 		void setSegment(int segment, int symbolType);
 		void setSymbol(int segment, int symbol);
+		bool displayEngineering(long value, int exponent, int unit);
+		bool displaySigned(long num);
+		bool displayHex(uint32_t num);
+		bool displayBase(uint32_t num, uint8_t base);
+		void setBoardProfile(const BoardProfile_t *profile);
+		bool setUsageTracking(bool state);
+		uint32_t getUsage(int tube, int digit);
+		void flushUsage(void);
+		bool saveConfig(backlight *rgb = NULL);
+		bool restoreConfig(backlight *rgb = NULL);
+		void startStopwatch(void);
+		void startCountdown(int h, int m, int s);
+		void pauseStopwatch(bool state);
+		void endStopwatch(void);
+		uint8_t getStopwatchMode(void);
+		uint32_t getStopwatch(void);
+		bool lapStopwatch(void);
+		uint8_t lapsTaken(void);
+		uint32_t getSplit(uint8_t lap);
+		uint32_t getLap(uint8_t lap);
+		void setAlarmCallback(AlarmCallback_t callback);
+		void update(void);
+		void tick(void);
 		
 };
 
+/*************************************************************************************
+ * Fade curves
+ *
+ * Each curve is a table of FADE_RESOLUTION points going from 0 to 65535, worked out
+ * by the compiler and placed in PROGMEM. A table only ends up in flash if something
+ * refers to it, so unused curves cost nothing. The maths here is only ever run by
+ * the compiler.
+ ************************************************************************************/
+static_assert(FADE_RESOLUTION >= 8 && FADE_RESOLUTION <= 4096 && !(FADE_RESOLUTION & (FADE_RESOLUTION - 1)),
+			  "FADE_RESOLUTION must be a power of 2 from 8 to 4096"); //fadeIn() and fadeOut() need 8
+
+constexpr double fadeCosTerm(double x2, double term, uint8_t n)
+{
+	return (n > 12) ? 0.0 : term + fadeCosTerm(x2, -term * x2 / ((2 * n + 1) * (2 * n + 2)), n + 1);
+}
+
+constexpr double fadeExpTerm(double x, double term, uint8_t n)
+{
+	return (n > 12) ? 0.0 : term + fadeExpTerm(x, term * x / (n + 1), n + 1);
+}
+
+constexpr double fadeExp2(double y) //2^y for y >= 0
+{
+	return (y >= 1.0) ? 2.0 * fadeExp2(y - 1.0) : fadeExpTerm(y * 0.69314718, 1.0, 0);
+}
+
+constexpr double fadeExp(double x) //e^x, halving x until the series converges quickly
+{
+	return (x > 0.5 || x < -0.5) ? fadeExp(x / 2.0) * fadeExp(x / 2.0) : fadeExpTerm(x, 1.0, 0);
+}
+
+constexpr double fadeAtanhTerm(double z2, double power, uint8_t n)
+{
+	return (n > 12) ? 0.0 : power / (2 * n + 1) + fadeAtanhTerm(z2, power * z2, n + 1);
+}
+
+constexpr double fadeLn(double x) //ln(x) for 0 < x <= 1, doubling x up to 0.5 first
+{
+	return (x < 0.5) ? fadeLn(x * 2.0) - 0.69314718 : 2.0 * fadeAtanhTerm(((x - 1.0) / (x + 1.0)) * ((x - 1.0) / (x + 1.0)), (x - 1.0) / (x + 1.0), 0);
+}
+
+constexpr double fadeCube(double x)
+{
+	return x * x * x;
+}
+
+/* y = f(t) for t between 0 and 1 */
+constexpr double fadeShape(uint8_t curve, double t)
+{
+	return (curve == CURVE_COSINE) ? (1.0 - fadeCosTerm(3.14159265 * t * 3.14159265 * t, 1.0, 0)) / 2.0 :
+		   (curve == CURVE_QUADRATIC) ? t * t :
+		   (curve == CURVE_EXPONENTIAL) ? (fadeExp2(10.0 * t) - 1.0) / 1023.0 :
+		   (curve == CURVE_PERCEPTUAL) ? ((t > 0.08) ? fadeCube((100.0 * t + 16.0) / 116.0) : 100.0 * t / 903.3) : //CIE lightness
+		   t;
+}
+
+constexpr uint16_t fadePoint(uint8_t curve, uint16_t i)
+{
+	return (uint16_t)(65535.0 * fadeShape(curve, (double)i / (FADE_RESOLUTION - 1)) + 0.5);
+}
+
+/* Builds the list 0, 1, ... N-1 to fill the tables with, halving each time to keep the
+ * template depth down */
+template<uint16_t... I> struct FadeIndices {};
+
+template<class A, class B> struct FadeJoin;
+template<uint16_t... A, uint16_t... B> struct FadeJoin<FadeIndices<A...>, FadeIndices<B...> > {
+	typedef FadeIndices<A..., (sizeof...(A) + B)...> type;
+};
+
+template<uint16_t N> struct FadeRange {
+	typedef typename FadeJoin<typename FadeRange<N / 2>::type, typename FadeRange<N - N / 2>::type>::type type;
+};
+template<> struct FadeRange<1> { typedef FadeIndices<0> type; };
+
+template<uint8_t Curve, class I = typename FadeRange<FADE_RESOLUTION>::type> struct FadeCurve;
+template<uint8_t Curve, uint16_t... I> struct FadeCurve<Curve, FadeIndices<I...> > {
+	static const uint16_t table[FADE_RESOLUTION];
+};
+
+template<uint8_t Curve, uint16_t... I>
+const uint16_t FadeCurve<Curve, FadeIndices<I...> >::table[FADE_RESOLUTION] PROGMEM = { fadePoint(Curve, I)... };
+
+/* Gamma correction for one LED, out = scale * (in / 255) ^ (tenths / 10) */
+constexpr uint8_t gammaPoint(uint8_t tenths, uint8_t scale, uint16_t i)
+{
+	return (i == 0) ? 0 : (uint8_t)(scale * fadeExp(fadeLn(i / 255.0) * tenths / 10.0) + 0.5);
+}
+
+template<uint8_t Tenths, uint8_t Scale, class I = typename FadeRange<256>::type> struct GammaTable;
+template<uint8_t Tenths, uint8_t Scale, uint16_t... I> struct GammaTable<Tenths, Scale, FadeIndices<I...> > {
+	static const uint8_t table[256];
+};
+
+template<uint8_t Tenths, uint8_t Scale, uint16_t... I>
+const uint8_t GammaTable<Tenths, Scale, FadeIndices<I...> >::table[256] PROGMEM = { gammaPoint(Tenths, Scale, I)... };
+
 class backlight
 {
 	public:
 
 		struct CycleType_t {
-			uint8_t colour[3];
+			uint8_t colour[3];				//r,g,b - or h,s,v for FADE_HSV
+			uint8_t mode;
 			uint16_t duration;
+			const uint16_t *curve;
 			CycleType_t *next;
 		};
 
-		static int black[3];
-		static int white[3];
-		static int red[3];
-		static int green[3];
-		static int blue[3];
-		static int yellow[3];
-		static int dimWhite[3];
-		static int magenta[3];
-		static int aqua[3];
-		static int purple[3];
+		/* Called from update() with the step number for ON_SEGMENT, 0 otherwise */
+		typedef void (*FadeCallback_t)(uint8_t step);
+
+		/* Output tables for each LED - must be stored in PROGMEM */
+		struct Calibration_t {
+			const uint8_t *channel[3];		//r,g,b tables of 256 entries, NULL to leave as is
+		};
+
+		/* A colour stored in PROGMEM, like the named colours below */
+		struct NamedColour_t {
+			uint8_t rgb[3];
+		};
+
+		/* Anything taking a colour takes an int[3] of r,g,b (or HSV()), or a named colour */
+		class Colour_t {
+			public:
+				Colour_t(const int colour[]);
+				Colour_t(const NamedColour_t &colour);
+				int operator[](uint8_t i) const;
+			private:
+				int _colour[3];
+		};
+
+		static const NamedColour_t black;
+		static const NamedColour_t white;
+		static const NamedColour_t red;
+		static const NamedColour_t green;
+		static const NamedColour_t blue;
+		static const NamedColour_t yellow;
+		static const NamedColour_t dimWhite;
+		static const NamedColour_t magenta;
+		static const NamedColour_t aqua;
+		static const NamedColour_t purple;
 		
 		volatile uint8_t currentColour[3];
 		
 		backlight(int redPin, int bluePin, int greenPin);
 		
-		void setColour(int colour[]);
-		void crossFade(int startColour[], int endColour[], int duration);
-		void fadeIn(int colour[], int duration);
+		void setColour(const Colour_t &colour);
+		static Colour_t getColour(const NamedColour_t &colour);
+		void crossFade(const Colour_t &startColour, const Colour_t &endColour, int duration);
+		void fadeIn(const Colour_t &colour, int duration);
 		void fadeOut(int duration);
 		bool setFade(int setup[][4], int fadeInTime);
-		void stopFade(int stopColour[], int duration);
+		bool setFade(int setup[][4], const uint16_t *curves[], int fadeInTime);
+		void stopFade(const Colour_t &stopColour, int duration);
+		bool setFadeStep(uint8_t step, const Colour_t &colour, int duration);
+		bool insertFadeStep(uint8_t step, const Colour_t &colour, int duration);
+		bool removeFadeStep(uint8_t step);
+		void setCalibration(const Calibration_t *profile);
+		void setOutputMode(uint8_t mode);
+		void setCallback(uint8_t event, FadeCallback_t callback);
+		void update(void);
+		uint8_t getFade(int setup[][4], uint8_t max);
+		uint8_t getFade(int setup[][4], const uint16_t *curves[], uint8_t max);
+		void setFadeSync(uint8_t unit);
+		void setFadeRate(uint16_t maxHz);
+		uint32_t getFadeRate(void);
+		void clockTick(uint8_t unit);
 		void isr(void);
 
 	private:
 
 		void timerSetup(void);
-		void updateAnalogPin(volatile uint8_t pin, uint8_t val);
-		CycleType_t *buildLoop(CycleType_t *working, uint16_t setup[][4], uint8_t index, uint8_t max);
+		void nextTick(void);
+		volatile uint8_t *pwmRegister(uint8_t pin);
+		volatile uint16_t *pwmRegister16(uint8_t pin);
+		CycleType_t *buildLoop(CycleType_t *working, int setup[][4], const uint16_t *curves[], uint8_t index, uint8_t max);
 		void freeLoop(CycleType_t *node, CycleType_t *endNode);
 		void swapNode(void);
+		CycleType_t *stepBefore(uint8_t step, uint8_t *count);
+		void collect(void);
+		void freeProgram(CycleType_t *program);
+		void postEvent(uint8_t event, uint8_t step);
+		void nodeColour(CycleType_t *node, uint8_t rgb[]);
+		static uint8_t calibrate(uint8_t channel, uint8_t val);
+		static uint16_t calibrate16(uint8_t channel, uint16_t level);
+		void selectOutput(void);
+		static void outputByte(uint8_t channel, uint16_t level);
+		static void outputWide(uint8_t channel, uint16_t level);
+		static void outputHighRes(uint8_t channel, uint16_t level);
+		static void outputDither(uint8_t channel, uint16_t level);
+		void setHighRes(uint8_t pin, bool enable);
+		void setTimerResolution(volatile uint8_t *tccrA, volatile uint8_t *tccrB, volatile uint16_t *icr, bool high);
+		void hsvToRgb(uint16_t hue, uint8_t sat, uint8_t val, uint8_t rgb[]);
+};
+
+class buttons
+{
+	private:
+
+		struct ButtonType_t {
+			uint8_t pin;
+			volatile uint8_t *port;		//input register for the pin
+			uint8_t mask;
+			uint8_t integrator;			//0 when released, up to BUTTON_INTEGRATOR when pressed
+			bool pressed;				//debounced state
+			uint16_t held;				//ticks held for, counted from the last repeat
+		};
+
+		ButtonType_t _button[BUTTON_COUNT];
+		uint8_t _count = 0;
+		bool _activeLow = 0;
+		uint16_t _longTicks;
+		uint16_t _repeatTicks;
+		uint8_t _events[BUTTON_QUEUE_SIZE];
+		volatile uint8_t _eventHead = 0;
+		volatile uint8_t _eventCount = 0;
+
+		void addButton(int pin);
+		void postEvent(uint8_t button, uint8_t event);
+
+	public:
+
+		buttons(int pin1, int pin2 = NO_BUTTON, int pin3 = NO_BUTTON, int pin4 = NO_BUTTON);
+
+		void setActiveLow(bool state);
+		void setLongPress(uint16_t ms);
+		void setRepeat(uint16_t ms);
+		bool isPressed(uint8_t button);
+		uint8_t available(void);
+		bool getEvent(uint8_t *button, uint8_t *event);
+		void clearEvents(void);
+		void tick(void);
+};
+
+class rtc
+{
+	private:
+
+		nixie *_tubes;
+		uint8_t _type;
+		uint8_t _interrupt;
+		volatile uint8_t _state = 0;
+		volatile bool _readPending = 0;
+		volatile bool _valid = 0;
+		uint8_t _buffer[4];
+		uint8_t _writeLength;
+		uint8_t _readLength;
+		uint8_t _index;
+
+		bool start(uint8_t writeLength, uint8_t readLength);
+		void step(void);
+		void finish(bool ok);
+
+	public:
+
+		rtc(nixie *tubes, int sqwPin, uint8_t type = RTC_DS3231);
+
+		void begin(void);
+		bool setTime(int h, int m, int s);
+		bool isValid(void);
+		bool busy(void);
+		void second(void);
+		void tick(void);
+};
+
+class remote
+{
+	private:
+
+		Stream *_port;
+		nixie *_tubes;
+		backlight *_rgb;
+		uint8_t _state = 0;
+		uint8_t _command;
+		uint8_t _length;
+		uint8_t _count = 0;
+		uint8_t _check;
+		char _buffer[REMOTE_BUFFER_SIZE + 1];
+
+		bool runText(void);
+		bool runBinary(void);
+		bool runFade(int values[], uint8_t count);
+		uint8_t parseInts(const char *text, int values[], uint8_t max);
+
+	public:
+
+		remote(Stream *port, nixie *tubes, backlight *rgb = NULL);
+
+		void update(void);
+		void feed(uint8_t c);
 };
 
 // Arduino 0012 workaround
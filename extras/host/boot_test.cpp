@@ -0,0 +1,138 @@
+/*
+	boot_test.cpp
+	Times restoreConfig() putting a saved clock and fade back, from the call to the
+	first restored frame lit, and checks the fade comes back as it was saved - the
+	one setFade() had waiting rather than the one it was about to replace, each
+	step on its own curve. Then saves a signed number rather than the clock, and
+	checks restoreConfig() shifts out the same bits that were on the tubes. Either
+	way the restored time mustn't count as synced.
+*/
+
+#include <Arduino.h>
+#include <NixieDriver.h>
+#include <stdio.h>
+#include "hal.h"
+
+#define DATA_PIN 8
+#define CLOCK_PIN 9
+#define OE_PIN 10
+#define FRAME_BITS 68
+#define BOOT_BUDGET_US 2000 //from restoreConfig() to the tubes lit
+
+nixie tubes(DATA_PIN, CLOCK_PIN, OE_PIN);
+backlight backlit(3, 5, 6);
+
+/* a curve of the sketch's own, which can't be saved */
+static uint16_t ownCurve[FADE_RESOLUTION];
+
+static uint64_t litAt;
+
+static void onPin(uint8_t pin, uint8_t level)
+{
+	if(pin == OE_PIN && level && !litAt) litAt = hal::cycles;
+}
+
+/* the bits of the last frame shifted out, taken as the clock falls */
+static uint8_t bits[FRAME_BITS];
+static uint8_t bitCount;
+
+static void onClock(uint8_t pin, uint8_t level)
+{
+	if(pin != CLOCK_PIN || level) return;
+	if(bitCount == FRAME_BITS) bitCount = 0; //the next frame
+	bits[bitCount++] = hal::getPin(DATA_PIN);
+}
+
+int main(void)
+{
+	bool failed = false;
+
+	for(uint16_t i = 0; i < FADE_RESOLUTION; i++)
+		ownCurve[i] = (uint32_t)i * 0xFFFF / (FADE_RESOLUTION - 1);
+
+	/* a clock on one fade, with a new one waiting for the end of the step */
+	int running[][4] = {{RED, 1000}, {BLUE, 1000}, {ENDCYCLE}};
+	int waiting[][4] = {{GREEN, 500}, {WHITE, 700}, {PURPLE, 900}, {ENDCYCLE}};
+	const uint16_t *curves[] = {EASE_LINEAR, EASE_PERCEPTUAL, ownCurve};
+	const uint16_t *restored[] = {EASE_LINEAR, EASE_PERCEPTUAL, EASE_COSINE};
+
+	tubes.setClockMode(true);
+	tubes.setTime(12, 34, 56);
+	tubes.updateTime();
+	backlit.setFade(running, 0);
+	hal::runMs(10);
+	backlit.setFade(waiting, curves, 0);
+	if(!tubes.saveConfig(&backlit))
+	{
+		printf("saveConfig() failed\n");
+		failed = true;
+	}
+
+	/* as if the power went off */
+	backlit.stopFade(backlit.black, 0);
+	tubes.setClockMode(false);
+	tubes.displayDigits(BLANK, BLANK, BLANK, BLANK, BLANK, BLANK);
+
+	hal::pinHook = onPin;
+	litAt = 0;
+	uint64_t start = hal::cycles;
+	if(!tubes.restoreConfig(&backlit))
+	{
+		printf("restoreConfig() failed\n");
+		failed = true;
+	}
+	uint64_t end = hal::cycles;
+	hal::pinHook = NULL;
+
+	double totalUs = (end - start) * 1000000.0 / F_CPU;
+	double litUs = litAt ? (litAt - start) * 1000000.0 / F_CPU : -1;
+	printf("restoreConfig() took %.0fus, tubes lit after %.0fus (budget %dus)\n",
+		totalUs, litUs, BOOT_BUDGET_US);
+	if(!litAt || litUs > BOOT_BUDGET_US) failed = true;
+	if(tubes.isTimeSynced())
+	{
+		printf("restored time counted as synced\n");
+		failed = true;
+	}
+
+	/* the fade that was waiting, with the curves that can be saved */
+	int setup[4][4];
+	const uint16_t *got[4];
+	uint8_t steps = backlit.getFade(setup, got, 4);
+	if(steps != 3)
+	{
+		printf("restored %d steps, not 3\n", steps);
+		failed = true;
+	}
+	for(uint8_t i = 0; i < steps && i < 3; i++)
+	{
+		if(memcmp(setup[i], waiting[i], sizeof(setup[i])) != 0 || got[i] != restored[i])
+		{
+			printf("step %d restored wrong\n", i);
+			failed = true;
+		}
+	}
+
+	/* a number rather than the clock, its sign on a symbol tube */
+	tubes.setClockMode(false);
+	tubes.setSegment(0, IN15A);
+	hal::pinHook = onClock;
+	bitCount = 0;
+	tubes.displaySigned(-4321);
+	uint8_t saved[FRAME_BITS];
+	memcpy(saved, bits, sizeof(saved));
+	bool savedWhole = (bitCount == FRAME_BITS);
+	tubes.saveConfig(NULL);
+
+	tubes.displayDigits(BLANK, BLANK, BLANK, BLANK, BLANK, BLANK);
+	tubes.setTime(1, 2, 3);
+	bitCount = 0;
+	tubes.restoreConfig(NULL);
+	hal::pinHook = NULL;
+	bool same = savedWhole && bitCount == FRAME_BITS && memcmp(bits, saved, sizeof(saved)) == 0;
+	printf("number restored %s\n", same ? "as it was shown" : "differently");
+	if(!same || tubes.isTimeSynced()) failed = true;
+
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+/*
+	drift_test.cpp
+	Runs fades 10,000 times round and checks every time round starts exactly a
+	whole number of loops after the first, to within the coarsest timer period.
+	The steps are picked so the fade goes through every TIMER1 prescaler each
+	time round, which is where counts used to be lost or reinterpreted.
+*/
+
+#include <Arduino.h>
+#include <NixieDriver.h>
+#include <stdio.h>
+#include "hal.h"
+
+#define LOOPS 10000
+#define TOLERANCE 1024 //cycles, the 64us period of the slowest prescaler
+
+backlight backlit(3, 5, 6);
+
+static uint64_t lastMatch; //when the last TIMER1 compare that was run happened
+static bool cycled;
+
+static void onInterrupt(uint8_t vector, uint64_t due, uint64_t entered)
+{
+	if(vector == hal::TIMER1_COMPA) lastMatch = due;
+}
+
+static void onCycle(uint8_t step)
+{
+	cycled = true;
+}
+
+/* go round setup LOOPS times at the rate cap given, returns the worst error in cycles */
+static int64_t drift(const char *name, int setup[][4], uint16_t maxHz)
+{
+	uint64_t loopCycles = 0;
+	for(uint8_t i = 0; setup[i][3] != 0; i++)
+		loopCycles += (uint64_t)setup[i][3] * hal::CYCLES_PER_MS;
+
+	backlit.setFadeRate(maxHz);
+	backlit.setFade(setup, 0);
+
+	uint64_t first = 0;
+	int64_t worst = 0;
+	uint32_t loops = 0;
+	cycled = false;
+	while(loops <= LOOPS && hal::step(hal::NEVER))
+	{
+		backlit.update();
+		if(!cycled) continue;
+		cycled = false;
+
+		if(loops == 0) first = lastMatch;
+		int64_t error = (int64_t)(lastMatch - first) - (int64_t)(loops * loopCycles);
+		if(error < 0) error = -error;
+		if(error > worst) worst = error;
+		loops++;
+	}
+	backlit.stopFade(backlit.black, 0);
+
+	printf("%-12s %u loops of %llums, worst drift %lld cycles (%.1fus)\n", name, loops - 1,
+		(unsigned long long)(loopCycles / hal::CYCLES_PER_MS), (long long)worst,
+		worst * 1000000.0 / F_CPU);
+	return worst;
+}
+
+int main(void)
+{
+	hal::interruptHook = onInterrupt;
+	backlit.setCallback(ON_CYCLE, onCycle);
+
+	/* 256 ticks a step: 2MHz for the first two, 250KHz for the others */
+	int fixed[][4] = {{RED, 20}, {GREEN, 5000}, {BLUE, 30000}, {WHITE, 60000}, {ENDCYCLE}};
+
+	/* one interrupt a second at most: 2MHz, 250KHz, 62.5KHz and 15.625KHz */
+	int capped[][4] = {{RED, 20}, {GREEN, 1000}, {BLUE, 10000}, {WHITE, 60000}, {ENDCYCLE}};
+
+	bool failed = false;
+	failed |= drift("fixed rate", fixed, 0) > TOLERANCE;
+	failed |= drift("capped rate", capped, 1) > TOLERANCE;
+
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
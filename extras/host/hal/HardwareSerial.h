@@ -0,0 +1,24 @@
+/*
+	HardwareSerial.h
+	Host stand-in for the Arduino's Serial, so sketches that use it build against
+	the hal. Nothing arrives and whatever is written is dropped - tests that need
+	a line give remote their own Stream.
+*/
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Stream.h"
+
+class HardwareSerial : public Stream
+{
+	public:
+		void begin(unsigned long baud) {}
+		int available(void) { return 0; }
+		int read(void) { return -1; }
+		size_t write(uint8_t c) { return 1; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,35 @@
+/*
+	Stream.h
+	Host stand-in for the Arduino Stream, enough for the remote class. Tests
+	subclass it to feed bytes in and collect what is written back.
+*/
+
+#ifndef Stream_h
+#define Stream_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class Stream
+{
+	public:
+		virtual ~Stream() {}
+		virtual int available(void) = 0;
+		virtual int read(void) = 0;
+		virtual size_t write(uint8_t c) = 0;
+
+		size_t print(const char *text)
+		{
+			size_t n = 0;
+			while(*text) n += write((uint8_t)*text++);
+			return n;
+		}
+		size_t println(const char *text)
+		{
+			size_t n = print(text);
+			return n + write('\r') + write('\n');
+		}
+};
+
+#endif
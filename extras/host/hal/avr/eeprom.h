@@ -0,0 +1,20 @@
+/*
+	avr/eeprom.h
+	Host stand-in. The EEPROM is hal::eeprom[], and is always ready.
+*/
+
+#ifndef _AVR_EEPROM_H_
+#define _AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define eeprom_is_ready() 1
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+uint16_t eeprom_read_word(const uint16_t *address);
+void eeprom_read_block(void *destination, const void *source, size_t length);
+void eeprom_update_byte(uint8_t *address, uint8_t value);
+void eeprom_update_block(const void *source, void *destination, size_t length);
+
+#endif
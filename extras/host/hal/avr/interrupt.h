@@ -0,0 +1,17 @@
+/*
+	avr/interrupt.h
+	Host stand-in. Interrupts only happen when hal.cpp runs the clock, so turning
+	them off and on has nothing to do.
+*/
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector) extern "C" void vector(void); extern "C" void vector(void)
+
+static inline void cli(void) {}
+static inline void sei(void) {}
+
+#endif
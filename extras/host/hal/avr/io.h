@@ -0,0 +1,140 @@
+/*
+	avr/io.h
+	Host stand-in for the ATmega328P registers the library uses. Most are plain
+	variables. TCNT1, TCCR1B and OCR1A are objects so hal.cpp can bring TIMER1 up
+	to date at the moment the library reads or writes them, which is what lets the
+	fade timing be checked against the clock cycle.
+
+	The 8 bit duty registers OCR0A, OCR0B, OCR2A and OCR2B are objects too, so
+	they can be traced. The library looks them up once and writes the duty through
+	a pointer, so & gives it the byte itself, and hal.cpp looks for a new value
+	at the end of each interrupt and each pin or EEPROM access.
+
+	TWCR is an object too. Writing it with TWINT set starts the next step on the
+	bus, which hal.cpp finishes - setting TWINT, TWSR and for a read TWDR - once
+	the bits have had time to go out at the rate in TWBR.
+
+	TIMER3 isn't on an ATmega328P. It stands in for an ATmega2560's on A0-A2, so
+	the backlight's 16 bit output routines can be run too.
+*/
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+class Timer1Count
+{
+	public:
+		operator uint16_t() const;
+		Timer1Count &operator=(uint16_t count);
+};
+
+class Timer1Compare
+{
+	public:
+		operator uint16_t() const;
+		Timer1Compare &operator=(uint16_t top);
+};
+
+class DutyRegister
+{
+	public:
+		volatile uint8_t value;
+		uint8_t traced; //the last value put in the trace
+
+		operator uint8_t() const { return value; }
+		DutyRegister &operator=(uint8_t duty);
+		volatile uint8_t *operator&() { return &value; }
+};
+
+class TwiControl
+{
+	public:
+		operator uint8_t() const;
+		TwiControl &operator=(uint8_t value);
+};
+
+class Timer1Control
+{
+	public:
+		operator uint8_t() const;
+		Timer1Control &operator=(uint8_t value);
+		Timer1Control &operator|=(uint8_t bits) { return *this = (uint8_t)(*this | bits); }
+		Timer1Control &operator&=(uint8_t bits) { return *this = (uint8_t)(*this & bits); }
+};
+
+extern volatile uint8_t SREG, MCUSR;
+extern volatile uint8_t TCCR0A, TCCR0B, TCNT0, TIMSK0, TIFR0;
+extern DutyRegister OCR0A, OCR0B;
+extern volatile uint8_t TCCR1A, TIMSK1, TIFR1;
+extern Timer1Count TCNT1;
+extern Timer1Control TCCR1B;
+extern Timer1Compare OCR1A;
+extern volatile uint16_t OCR1B, ICR1;
+extern volatile uint8_t TCCR2A, TCCR2B;
+extern DutyRegister OCR2A, OCR2B;
+extern volatile uint8_t TCCR3A, TCCR3B;
+extern volatile uint16_t OCR3A, OCR3B, OCR3C, ICR3;
+extern TwiControl TWCR;
+extern volatile uint8_t TWSR, TWBR, TWDR;
+extern volatile uint8_t EIMSK, EICRA;
+extern volatile uint8_t UCSR0B, UDR0;
+
+/* avr-libc's registers are macros, and the library checks for them with #if defined() */
+#define TCCR0A TCCR0A
+#define TCCR2A TCCR2A
+#define TCCR3A TCCR3A
+#define ICR3 ICR3
+
+/* TIMER0 */
+#define COM0A1 7
+#define COM0B1 5
+#define OCIE0A 1
+#define OCIE0B 2
+
+/* TIMER1 */
+#define COM1A1 7
+#define COM1B1 5
+#define WGM13 4
+#define WGM12 3
+#define WGM11 1
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define OCIE1A 1
+#define TOIE1 0
+
+/* TIMER2 */
+#define COM2A1 7
+#define COM2B1 5
+
+/* TIMER3 */
+#define COM3A1 7
+#define COM3B1 5
+#define COM3C1 3
+
+/* TWI */
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWEN 2
+#define TWIE 0
+
+/* external interrupts */
+#define INT0 0
+#define INT1 1
+#define ISC01 1
+#define ISC11 3
+
+/* USART */
+#define RXCIE0 7
+
+#define E2END 0x3FF
+
+#endif
@@ -0,0 +1,793 @@
+/*
+	hal.cpp
+	The simulated ATmega328P behind the host build of NixieDriver - see hal.h.
+*/
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include "hal.h"
+
+extern "C" void TIMER0_COMPA_vect(void);
+extern "C" void TIMER1_COMPA_vect(void);
+
+/*************************************************************************************
+ * Registers
+ ************************************************************************************/
+volatile uint8_t SREG = 0x80, MCUSR;
+volatile uint8_t TCCR0A, TCCR0B, TCNT0, TIMSK0, TIFR0;
+DutyRegister OCR0A, OCR0B;
+volatile uint8_t TCCR1A, TIMSK1, TIFR1;
+Timer1Count TCNT1;
+Timer1Control TCCR1B;
+Timer1Compare OCR1A;
+volatile uint16_t OCR1B, ICR1;
+volatile uint8_t TCCR2A, TCCR2B;
+DutyRegister OCR2A, OCR2B;
+volatile uint8_t TCCR3A, TCCR3B;
+volatile uint16_t OCR3A, OCR3B, OCR3C, ICR3;
+TwiControl TWCR;
+volatile uint8_t TWSR, TWBR, TWDR;
+volatile uint8_t EIMSK, EICRA;
+volatile uint8_t UCSR0B, UDR0;
+HardwareSerial Serial;
+
+/*************************************************************************************
+ * State
+ ************************************************************************************/
+uint64_t hal::cycles = 0;
+uint16_t hal::isrCycles[hal::VECTORS] = {640, 160};
+uint16_t hal::pinCycles = 50;
+uint16_t hal::eepromCycles = 12;
+hal::InterruptHook_t hal::interruptHook = NULL;
+hal::PinHook_t hal::pinHook = NULL;
+uint8_t hal::eeprom[E2END + 1];
+uint32_t hal::isrEepromWrites = 0;
+std::vector<hal::TraceEvent_t> hal::traceEvents;
+hal::ClockChip_t hal::clockChip = {{0}, false, true, 0, 0xFF, 0};
+
+static const uint16_t prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+static uint64_t t1Sync = 0; //cycle TIMER1 was last brought up to
+static uint16_t t1Count = 0;
+static uint8_t t1Control = 0;
+static uint16_t t1Top = 0; //OCR1A
+static bool t1Flag = false; //OCF1A
+static uint64_t t1FlagAt;
+
+static uint64_t t0Last = 0; //compares up to here have been serviced, or passed unseen
+static uint64_t t0Period = ~(uint64_t)0; //the count of 256 OCR0A was last latched for
+static uint8_t t0Compare; //OCR0A as latched
+static uint8_t t0Before; //and as it was for the period before, for a compare passed inside an interrupt
+
+static bool inIsr = false;
+static bool tracing = false;
+
+static uint8_t pins[20];
+static volatile uint8_t portOut[5], portIn[5];
+static void (*external[2])(void);
+
+static bool eepromErased = false;
+
+enum {TWI_FREE, TWI_ADDRESS, TWI_WRITE, TWI_READ, TWI_IGNORED};
+static uint8_t twiControl = 0; //TWCR as written, less TWINT and TWSTO
+static uint8_t twiPhase = TWI_FREE; //what the next byte on the bus is
+static bool twiPointed; //the register pointer has been written this transfer
+static bool twiFlag = false; //TWINT
+static uint64_t twiDoneAt = hal::NEVER; //the step going out finishes here
+static uint64_t twiStopAt = 0; //TWSTO reads set until here
+static uint8_t twiStatus, twiData; //TWSR and TWDR once it has
+
+static uint8_t chipPointer = 0;
+static uint64_t chipNext = hal::NEVER; //the chip's next second starts here
+
+/*************************************************************************************
+ * Trace of the duty registers
+ ************************************************************************************/
+
+/* in REG_ order, so a register's signal is TRACE_REG + its index */
+static DutyRegister *const dutyRegisters[] = {std::addressof(OCR0A), std::addressof(OCR0B),
+											  std::addressof(OCR2A), std::addressof(OCR2B)};
+
+static void traceRegister(uint8_t reg, uint16_t value)
+{
+	hal::traceEvents.push_back((hal::TraceEvent_t){hal::cycles, (uint8_t)(hal::TRACE_REG + reg), value});
+}
+
+/* anything written through a pointer since the last look */
+static void traceDuty(void)
+{
+	if(!tracing) return;
+	for(uint8_t i = 0; i < sizeof(dutyRegisters) / sizeof(dutyRegisters[0]); i++)
+	{
+		DutyRegister *duty = dutyRegisters[i];
+		if(duty->value == duty->traced) continue;
+		duty->traced = duty->value;
+		traceRegister(i, duty->traced);
+	}
+}
+
+DutyRegister &DutyRegister::operator=(uint8_t duty)
+{
+	value = duty;
+	traceDuty();
+	return *this;
+}
+
+/*************************************************************************************
+ * TIMER1
+ ************************************************************************************/
+
+/* count the prescaler edges since the last update, clearing on OCR1A in CTC mode */
+static void timer1Update(void)
+{
+	uint16_t ps = prescale[t1Control & 0x07];
+	if(ps == 0)
+	{
+		t1Sync = hal::cycles;
+		return;
+	}
+
+	uint64_t edge = t1Sync / ps;
+	uint64_t last = hal::cycles / ps;
+	t1Sync = hal::cycles;
+
+	while(edge < last)
+	{
+		bool ctc = t1Control & (1 << WGM12);
+		uint16_t top = ctc ? t1Top : 0xFFFF;
+		if(t1Count == top)
+		{
+			t1Count = 0;
+			edge++;
+			continue;
+		}
+
+		uint64_t distance = (uint16_t)(top - t1Count);
+		if(last - edge < distance)
+		{
+			t1Count += (uint16_t)(last - edge);
+			break;
+		}
+
+		edge += distance;
+		t1Count = top;
+		if(ctc && !t1Flag)
+		{
+			t1Flag = true;
+			t1FlagAt = edge * ps;
+		}
+
+		/* skip whole periods, ending back on top */
+		uint64_t period = (uint64_t)top + 1;
+		if(last - edge > period)
+			edge += (last - edge - 1) / period * period;
+	}
+}
+
+static uint64_t timer1Due(void)
+{
+	timer1Update();
+	if(!(TIMSK1 & (1 << OCIE1A))) return hal::NEVER;
+	if(t1Flag) return t1FlagAt;
+
+	uint16_t ps = prescale[t1Control & 0x07];
+	if(ps == 0 || !(t1Control & (1 << WGM12))) return hal::NEVER;
+
+	uint16_t top = t1Top;
+	uint64_t distance = (t1Count == top) ? (uint64_t)top + 1 : (uint16_t)(top - t1Count);
+	return (hal::cycles / ps + distance) * ps;
+}
+
+Timer1Count::operator uint16_t() const
+{
+	timer1Update();
+	return t1Count;
+}
+
+Timer1Count &Timer1Count::operator=(uint16_t count)
+{
+	timer1Update();
+	t1Count = count;
+	return *this;
+}
+
+Timer1Compare::operator uint16_t() const
+{
+	return t1Top;
+}
+
+Timer1Compare &Timer1Compare::operator=(uint16_t top)
+{
+	timer1Update(); //up to now against the old top
+	if(tracing && top != t1Top) traceRegister(hal::REG_OCR1A, top);
+	t1Top = top;
+	return *this;
+}
+
+Timer1Control::operator uint8_t() const
+{
+	return t1Control;
+}
+
+Timer1Control &Timer1Control::operator=(uint8_t value)
+{
+	timer1Update(); //up to now at the old speed
+	t1Control = value;
+	return *this;
+}
+
+/*************************************************************************************
+ * TIMER0 - fast PWM at 64 cycles a count, for millis(). OCR0A is double buffered,
+ * so a new value only takes effect from the next time round.
+ ************************************************************************************/
+
+/* latch OCR0A at BOTTOM, if the clock has gone into a new period - value is what it held there */
+static void timer0Latch(uint8_t value)
+{
+	uint64_t period = hal::cycles / (256 * 64);
+	if(period > t0Period || t0Period == ~(uint64_t)0)
+	{
+		t0Before = (period == t0Period + 1) ? t0Compare : value;
+		t0Period = period;
+		t0Compare = value;
+	}
+}
+
+/* the first compare with OCR0A after the cycle given, a period not yet begun taking it as it is now */
+static uint64_t timer0Compare(uint64_t after)
+{
+	for(uint64_t period = after / (256 * 64);; period++)
+	{
+		uint8_t compare = (period < t0Period) ? t0Before : (period == t0Period) ? t0Compare : OCR0A;
+		uint64_t at = (period * 256 + compare) * 64;
+		if(at > after) return at;
+	}
+}
+
+static uint64_t timer0Due(void)
+{
+	if(!(TIMSK0 & (1 << OCIE0A)))
+	{
+		t0Last = hal::cycles;
+		return hal::NEVER;
+	}
+	return timer0Compare(t0Last);
+}
+
+/*************************************************************************************
+ * TWI, with the RTC on it
+ ************************************************************************************/
+static uint8_t chipSize(void)
+{
+	return hal::clockChip.ds1307 ? 0x40 : 0x13;
+}
+
+/* 1Hz, from the control register */
+static bool chipSquareWave(void)
+{
+	if(hal::clockChip.ds1307) return (hal::clockChip.registers[0x07] & 0x13) == 0x10; //SQWE, RS 00
+	return (hal::clockChip.registers[0x0E] & 0x1C) == 0x00; //not INTCN, RS 00
+}
+
+/* count a BCD register on, returning whether it went round */
+static bool chipCount(uint8_t reg, uint8_t mask, uint8_t wrap)
+{
+	uint8_t *bcd = &hal::clockChip.registers[reg];
+	uint8_t value = ((*bcd & mask) >> 4) * 10 + (*bcd & 0x0F) + 1;
+	bool round = (value == wrap);
+	if(round) value = 0;
+	*bcd = (*bcd & ~mask) | ((value / 10) << 4) | (value % 10);
+	return round;
+}
+
+/* the seconds the chip has seen start since it was last looked at */
+static void chipCatchUp(void)
+{
+	while(hal::cycles >= chipNext)
+	{
+		chipNext += F_CPU;
+		if(chipCount(0x00, 0x7F, 60) && chipCount(0x01, 0x7F, 60)) chipCount(0x02, 0x3F, 24);
+	}
+}
+
+/* the next edge of the square wave - it falls as each second starts and rises half way through */
+static uint64_t chipDue(void)
+{
+	if(chipNext == hal::NEVER || hal::clockChip.sqwPin == 0xFF || !chipSquareWave()) return hal::NEVER;
+	return (pins[hal::clockChip.sqwPin] == LOW) ? chipNext - F_CPU / 2 : chipNext;
+}
+
+static void chipEdge(void)
+{
+	chipCatchUp();
+	hal::setPin(hal::clockChip.sqwPin, !pins[hal::clockChip.sqwPin]);
+}
+
+void hal::setClock(uint8_t h, uint8_t m, uint8_t s)
+{
+	memset(clockChip.registers, 0, sizeof(clockChip.registers));
+	if(clockChip.ds1307) clockChip.registers[0x07] = 0x03; //square wave off
+	else clockChip.registers[0x0E] = 0x1C; //INTCN
+	clockChip.registers[0x00] = ((s / 10) << 4) | (s % 10);
+	clockChip.registers[0x01] = ((m / 10) << 4) | (m % 10);
+	clockChip.registers[0x02] = ((h / 10) << 4) | (h % 10);
+	chipNext = cycles + F_CPU;
+}
+
+/* a byte to the chip */
+static void chipWrite(uint8_t value)
+{
+	if(!twiPointed)
+	{
+		chipPointer = value % chipSize();
+		twiPointed = true;
+		return;
+	}
+	chipCatchUp();
+	hal::clockChip.registers[chipPointer] = value;
+	if(chipPointer == 0x00) chipNext = hal::cycles + F_CPU; //writing the seconds starts the second again
+	chipPointer = (chipPointer + 1) % chipSize();
+}
+
+static uint8_t chipRead(void)
+{
+	chipCatchUp();
+	uint8_t value = hal::clockChip.registers[chipPointer];
+	chipPointer = (chipPointer + 1) % chipSize();
+	return value;
+}
+
+/* SCL periods of bits */
+static uint64_t twiBits(uint8_t bits)
+{
+	static const uint8_t twiPrescale[4] = {1, 4, 16, 64};
+	return (uint64_t)bits * (16 + 2 * TWBR * twiPrescale[TWSR & 0x03]);
+}
+
+/* the step going out, if it has finished */
+static void twiSettle(void)
+{
+	if(hal::cycles < twiDoneAt) return;
+	twiDoneAt = hal::NEVER;
+	TWSR = (TWSR & 0x03) | twiStatus;
+	if(twiPhase == TWI_READ) TWDR = twiData;
+	twiFlag = true;
+}
+
+static void twiFinish(uint8_t bits, uint8_t status)
+{
+	twiStatus = status;
+	twiDoneAt = hal::cycles + twiBits(bits);
+}
+
+TwiControl::operator uint8_t() const
+{
+	twiSettle();
+	return twiControl | (twiFlag ? (1 << TWINT) : 0) | (hal::cycles < twiStopAt ? (1 << TWSTO) : 0);
+}
+
+TwiControl &TwiControl::operator=(uint8_t value)
+{
+	twiSettle();
+	twiControl = value & ~((1 << TWINT) | (1 << TWSTO) | (1 << TWSTA));
+	if(!(value & (1 << TWINT)) || !(value & (1 << TWEN))) return *this; //writing TWINT clears it and starts the next step
+
+	twiFlag = false;
+	if(value & (1 << TWSTO))
+	{
+		twiPhase = TWI_FREE;
+		twiDoneAt = hal::NEVER;
+		twiStopAt = hal::cycles + twiBits(1); //no TWINT for a stop
+		return *this;
+	}
+
+	if(hal::clockChip.busErrors)
+	{
+		hal::clockChip.busErrors--;
+		twiPhase = TWI_FREE;
+		twiFinish(1, 0x00);
+		return *this;
+	}
+
+	if(value & (1 << TWSTA))
+	{
+		twiFinish(1, (twiPhase == TWI_FREE) ? 0x08 : 0x10);
+		twiPhase = TWI_ADDRESS;
+		return *this;
+	}
+
+	switch(twiPhase)
+	{
+		case TWI_ADDRESS:
+		{
+			bool read = TWDR & 1;
+			if((TWDR >> 1) != 0x68 || !hal::clockChip.present)
+			{
+				twiPhase = TWI_IGNORED;
+				twiFinish(9, read ? 0x48 : 0x20);
+				break;
+			}
+			if(read) hal::clockChip.reads++;
+			else twiPointed = false;
+			twiPhase = read ? TWI_READ : TWI_WRITE;
+			twiFinish(9, read ? 0x40 : 0x18);
+			break;
+		}
+
+		case TWI_WRITE:
+			chipWrite(TWDR);
+			twiFinish(9, 0x28);
+			break;
+
+		case TWI_READ:
+			twiData = chipRead();
+			twiFinish(9, (value & (1 << TWEA)) ? 0x50 : 0x58);
+			break;
+
+		default: //nobody there to answer
+			twiFinish(9, 0x30);
+			break;
+	}
+	return *this;
+}
+
+/*************************************************************************************
+ * Running the clock
+ ************************************************************************************/
+
+/* run the interrupt that is due next, if it is due by until */
+bool hal::step(uint64_t until)
+{
+	if(inIsr) return false;
+
+	timer0Latch(OCR0A); //nothing has run since BOTTOM to change it
+	uint64_t due[VECTORS] = {timer1Due(), timer0Due()};
+	uint8_t vector = (due[TIMER0_COMPA] < due[TIMER1_COMPA]) ? TIMER0_COMPA : TIMER1_COMPA;
+
+	/* the RTC's square wave, if it comes first */
+	uint64_t edge = chipDue();
+	if(edge < due[vector])
+	{
+		if(edge > until) return false;
+		if(cycles < edge) cycles = edge;
+		chipEdge();
+		return true;
+	}
+	if(due[vector] == NEVER || due[vector] > until) return false;
+
+	if(cycles < due[vector]) cycles = due[vector];
+	uint64_t entered = cycles;
+	timer0Latch(OCR0A);
+	uint8_t ocr0a = OCR0A; //for a BOTTOM passed while the handler runs
+
+	/* the flag clears as the handler is entered */
+	if(vector == TIMER1_COMPA)
+	{
+		timer1Update();
+		t1Flag = false;
+	}
+	else
+		t0Last = entered;
+
+	inIsr = true;
+	if(tracing) traceEvents.push_back((TraceEvent_t){entered, (uint8_t)(TRACE_ISR + vector), 1});
+	cycles += isrCycles[vector];
+	if(vector == TIMER1_COMPA)
+		TIMER1_COMPA_vect();
+	else
+		TIMER0_COMPA_vect();
+	timer0Latch(ocr0a);
+	traceDuty();
+	if(tracing) traceEvents.push_back((TraceEvent_t){cycles, (uint8_t)(TRACE_ISR + vector), 0});
+	inIsr = false;
+
+	if(interruptHook != NULL) interruptHook(vector, due[vector], entered);
+	return true;
+}
+
+void hal::run(uint64_t until)
+{
+	while(step(until));
+	if(cycles < until) cycles = until;
+	traceDuty();
+}
+
+void hal::runMs(uint32_t ms)
+{
+	run(cycles + (uint64_t)ms * CYCLES_PER_MS);
+}
+
+bool hal::inInterrupt(void)
+{
+	return inIsr;
+}
+
+/* time taken by the code running now - outside an interrupt, others can run meanwhile */
+static void spend(uint32_t n)
+{
+	traceDuty();
+	if(inIsr) hal::cycles += n;
+	else hal::run(hal::cycles + n);
+}
+
+/*************************************************************************************
+ * Pins - 0-7 on PORTD, 8-13 on PORTB and A0-A5 (14-19) on PORTC, as on the Uno
+ ************************************************************************************/
+void hal::setPin(uint8_t pin, uint8_t level)
+{
+	uint8_t was = pins[pin];
+	pins[pin] = level ? HIGH : LOW;
+	if(pins[pin] != was)
+	{
+		if(tracing) traceEvents.push_back((TraceEvent_t){cycles, pin, pins[pin]});
+		if(pinHook != NULL) pinHook(pin, pins[pin]);
+	}
+
+	uint8_t mask = digitalPinToBitMask(pin);
+	volatile uint8_t *in = portInputRegister(digitalPinToPort(pin));
+	if(level) *in |= mask;
+	else *in &= ~mask;
+
+	uint8_t interrupt = digitalPinToInterrupt(pin);
+	if(was && !level && interrupt < 2 && external[interrupt] != NULL && !inIsr)
+	{
+		inIsr = true;
+		external[interrupt]();
+		inIsr = false;
+	}
+}
+
+uint8_t hal::getPin(uint8_t pin)
+{
+	return pins[pin];
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	if(mode == INPUT_PULLUP) hal::setPin(pin, HIGH);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+	spend(hal::pinCycles);
+	hal::setPin(pin, val);
+}
+
+int digitalRead(uint8_t pin)
+{
+	spend(hal::pinCycles);
+	return pins[pin];
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+	DutyRegister *ocr = NULL;
+	switch(digitalPinToTimer(pin))
+	{
+		case TIMER0A: ocr = std::addressof(OCR0A); break;
+		case TIMER0B: ocr = std::addressof(OCR0B); break;
+		case TIMER2A: ocr = std::addressof(OCR2A); break;
+		case TIMER2B: ocr = std::addressof(OCR2B); break;
+		case TIMER3A: OCR3A = val; return;
+		case TIMER3B: OCR3B = val; return;
+		case TIMER3C: OCR3C = val; return;
+		default: break;
+	}
+	if(ocr != NULL) *ocr = val;
+	else digitalWrite(pin, val < 128 ? LOW : HIGH);
+}
+
+uint8_t digitalPinToTimer(uint8_t pin)
+{
+	switch(pin)
+	{
+		case 3: return TIMER2B;
+		case 5: return TIMER0B;
+		case 6: return TIMER0A;
+		case 9: return TIMER1A;
+		case 10: return TIMER1B;
+		case 11: return TIMER2A;
+		case 14: return TIMER3A; //A0-A2, standing in for an ATmega2560's TIMER3
+		case 15: return TIMER3B;
+		case 16: return TIMER3C;
+		default: return NOT_ON_TIMER;
+	}
+}
+
+uint8_t digitalPinToPort(uint8_t pin)
+{
+	return (pin < 8) ? 4 : (pin < 14) ? 2 : 3;
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin)
+{
+	return 1 << ((pin < 8) ? pin : (pin < 14) ? pin - 8 : pin - 14);
+}
+
+uint8_t digitalPinToInterrupt(uint8_t pin)
+{
+	return (pin == 2) ? 0 : (pin == 3) ? 1 : 0xFF;
+}
+
+volatile uint8_t *portOutputRegister(uint8_t port)
+{
+	return &portOut[port];
+}
+
+volatile uint8_t *portInputRegister(uint8_t port)
+{
+	return &portIn[port];
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode)
+{
+	if(interrupt < 2 && mode == FALLING) external[interrupt] = handler;
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+	if(interrupt < 2) external[interrupt] = NULL;
+}
+
+/*************************************************************************************
+ * Trace
+ ************************************************************************************/
+void hal::traceStart(void)
+{
+	traceEvents.clear();
+	tracing = true;
+
+	/* where each register starts */
+	for(uint8_t i = 0; i < sizeof(dutyRegisters) / sizeof(dutyRegisters[0]); i++)
+	{
+		dutyRegisters[i]->traced = dutyRegisters[i]->value;
+		traceRegister(i, dutyRegisters[i]->traced);
+	}
+	traceRegister(REG_OCR1A, t1Top);
+}
+
+void hal::traceStop(void)
+{
+	tracing = false;
+}
+
+/* bits in a signal, more than one for a register */
+static uint8_t signalWidth(uint8_t signal)
+{
+	if(signal < hal::TRACE_REG) return 1;
+	return (signal == hal::TRACE_REG + hal::REG_OCR1A) ? 16 : 8;
+}
+
+/* a value change, as a vector for a register */
+static void vcdValue(FILE *vcd, uint8_t signal, uint16_t level, char id)
+{
+	uint8_t width = signalWidth(signal);
+	if(width == 1)
+	{
+		fprintf(vcd, "%d%c\n", level, id);
+		return;
+	}
+
+	fputc('b', vcd);
+	for(int8_t bit = width - 1; bit >= 0; bit--)
+		fputc((level & (1 << bit)) ? '1' : '0', vcd);
+	fprintf(vcd, " %c\n", id);
+}
+
+/* the signals given, from the trace, at 100ps a unit so a cycle is a whole 625 */
+bool hal::writeVcd(const char *path, const uint8_t signals[], const char *const names[], uint8_t count)
+{
+	FILE *vcd = fopen(path, "w");
+	if(vcd == NULL) return false;
+
+	fprintf(vcd, "$timescale 100 ps $end\n$scope module nixie $end\n");
+	for(uint8_t i = 0; i < count; i++)
+	{
+		uint8_t width = signalWidth(signals[i]);
+		fprintf(vcd, "$var %s %d %c %s $end\n", (width == 1) ? "wire" : "reg", width, '!' + i, names[i]);
+	}
+	fprintf(vcd, "$upscope $end\n$enddefinitions $end\n");
+
+	uint64_t start = traceEvents.empty() ? 0 : traceEvents.front().at;
+	uint64_t last = ~(uint64_t)0;
+	fprintf(vcd, "#0\n$dumpvars\n");
+	for(uint8_t i = 0; i < count; i++)
+	{
+		/* the level before the first change, or where it was left - a register starts with its value */
+		uint16_t level = (signals[i] < TRACE_ISR) ? pins[signals[i]] : 0;
+		for(size_t j = 0; j < traceEvents.size(); j++)
+			if(traceEvents[j].signal == signals[i])
+			{
+				level = (signals[i] < TRACE_REG) ? !traceEvents[j].level : traceEvents[j].level;
+				break;
+			}
+		vcdValue(vcd, signals[i], level, '!' + i);
+	}
+	fprintf(vcd, "$end\n");
+
+	for(size_t j = 0; j < traceEvents.size(); j++)
+	{
+		const TraceEvent_t &event = traceEvents[j];
+		for(uint8_t i = 0; i < count; i++)
+		{
+			if(event.signal != signals[i]) continue;
+			if(event.at != last)
+			{
+				fprintf(vcd, "#%llu\n", (unsigned long long)((event.at - start) * 625));
+				last = event.at;
+			}
+			vcdValue(vcd, event.signal, event.level, '!' + i);
+		}
+	}
+	return fclose(vcd) == 0;
+}
+
+/*************************************************************************************
+ * Time - delays run the clock, unless they are inside an interrupt
+ ************************************************************************************/
+unsigned long millis(void)
+{
+	return hal::cycles / hal::CYCLES_PER_MS;
+}
+
+unsigned long micros(void)
+{
+	return hal::cycles / clockCyclesPerMicrosecond();
+}
+
+void delay(unsigned long ms)
+{
+	if(inIsr) hal::cycles += (uint64_t)ms * hal::CYCLES_PER_MS;
+	else hal::runMs(ms);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	if(inIsr) hal::cycles += (uint64_t)us * clockCyclesPerMicrosecond();
+	else hal::run(hal::cycles + (uint64_t)us * clockCyclesPerMicrosecond());
+}
+
+/*************************************************************************************
+ * EEPROM - erased to 0xFF like a new chip
+ ************************************************************************************/
+static uint8_t *eepromCell(const void *address)
+{
+	if(!eepromErased)
+	{
+		memset(hal::eeprom, 0xFF, sizeof(hal::eeprom));
+		eepromErased = true;
+	}
+	return &hal::eeprom[(uintptr_t)address & E2END];
+}
+
+uint8_t eeprom_read_byte(const uint8_t *address)
+{
+	spend(hal::eepromCycles);
+	return *eepromCell(address);
+}
+
+uint16_t eeprom_read_word(const uint16_t *address)
+{
+	return eeprom_read_byte((const uint8_t *)address) | (eeprom_read_byte((const uint8_t *)address + 1) << 8);
+}
+
+void eeprom_read_block(void *destination, const void *source, size_t length)
+{
+	for(size_t i = 0; i < length; i++)
+		((uint8_t *)destination)[i] = eeprom_read_byte((const uint8_t *)source + i);
+}
+
+void eeprom_update_byte(uint8_t *address, uint8_t value)
+{
+	if(inIsr) hal::isrEepromWrites++;
+	*eepromCell(address) = value;
+}
+
+void eeprom_update_block(const void *source, void *destination, size_t length)
+{
+	for(size_t i = 0; i < length; i++)
+		eeprom_update_byte((uint8_t *)destination + i, ((const uint8_t *)source)[i]);
+}
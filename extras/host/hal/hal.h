@@ -0,0 +1,113 @@
+/*
+	hal.h
+	Controls for the simulated ATmega328P the host build of NixieDriver runs on.
+
+	Nothing happens on its own - time moves on when a test calls run() or step(),
+	or the library calls delay(), and while it does the TIMER1 and TIMER0 compare
+	interrupts are run when the simulated timers say they are due, highest
+	priority first and never nested, as on the chip. TIMER1 counts at whatever
+	prescaler TCCR1B is set to, on the edges of the one free running prescaler, so
+	counts the library loses or reinterprets show up as time.
+
+	Code doesn't cost anything by itself, so each interrupt is charged a fixed
+	number of cycles before its handler runs, and every digitalWrite(),
+	digitalRead() and EEPROM byte read some more. The numbers are rough figures
+	for a 16MHz Uno; isr_test checks the fade ISR's really does cover its worst
+	tick. Outside an interrupt those cycles run the clock, so an
+	interrupt that comes due part way through the sketch's shift() is run there,
+	as on the chip.
+
+	A DS3231 or DS1307 answers at 0x68 on the TWI bus once setClock() powers it
+	up, keeping BCD time in its registers. Its 1Hz square wave, once turned on,
+	falls on sqwPin through setPin() as each second starts, as the real chip's
+	does. A test can take it off the bus or have the next steps end in a bus
+	error.
+
+	Between traceStart() and traceStop() every pin change, and every interrupt
+	as a signal high while its handler runs, is kept in traceEvents - what a
+	logic analyser on the real board would show - for a test to measure and
+	for writeVcd() to save for a waveform viewer. So are the PWM duty registers
+	and OCR1A, each as its value from traceStart() and then whenever it changes.
+	A duty written through the library's pointer is seen by the end of the
+	interrupt that wrote it.
+*/
+
+#ifndef hal_h
+#define hal_h
+
+#include <stdint.h>
+#include <vector>
+#include <avr/io.h>
+
+namespace hal
+{
+	/* interrupts, in priority order */
+	enum
+	{
+		TIMER1_COMPA,
+		TIMER0_COMPA,
+		VECTORS
+	};
+
+	const uint64_t NEVER = ~(uint64_t)0;
+	const uint32_t CYCLES_PER_MS = F_CPU / 1000;
+
+	/* registers traced, in the order they are numbered from TRACE_REG */
+	enum
+	{
+		REG_OCR0A,
+		REG_OCR0B,
+		REG_OCR2A,
+		REG_OCR2B,
+		REG_OCR1A,
+		REGISTERS
+	};
+
+	/* trace signals: pins are their own number, interrupts from TRACE_ISR, registers from TRACE_REG */
+	const uint8_t TRACE_ISR = 32;
+	const uint8_t TRACE_REG = 48;
+
+	struct TraceEvent_t {
+		uint64_t at;		//cycle
+		uint8_t signal;		//pin, TRACE_ISR + vector or TRACE_REG + register
+		uint16_t level;		//or the register's value
+	};
+
+	/* the RTC on the TWI bus */
+	struct ClockChip_t {
+		uint8_t registers[64];	//seconds, minutes, hours in BCD from 0
+		bool ds1307;			//64 registers and SQWE in 0x07, rather than 19 and INTCN in 0x0E
+		bool present;			//acknowledges its address
+		uint8_t busErrors;		//bus steps still to end in a bus error
+		uint8_t sqwPin;			//where the square wave goes, 0xFF for nowhere
+		uint32_t reads;			//transfers that read from it
+	};
+
+	typedef void (*InterruptHook_t)(uint8_t vector, uint64_t due, uint64_t entered);
+	typedef void (*PinHook_t)(uint8_t pin, uint8_t level);
+
+	extern uint64_t cycles; //CPU clock cycles since reset
+	extern uint16_t isrCycles[VECTORS]; //charged to each interrupt before its handler runs
+	extern uint16_t pinCycles; //charged to each digitalWrite() and digitalRead()
+	extern uint16_t eepromCycles; //charged to each byte read from the EEPROM
+	extern InterruptHook_t interruptHook; //told about every interrupt once it has run
+	extern PinHook_t pinHook; //told about every pin that changes level
+	extern uint8_t eeprom[E2END + 1]; //erased to 0xFF the first time the library uses it
+	extern uint32_t isrEepromWrites; //EEPROM bytes written from inside an interrupt
+	extern std::vector<TraceEvent_t> traceEvents;
+	extern ClockChip_t clockChip;
+
+	bool step(uint64_t until);
+	void run(uint64_t until);
+	void runMs(uint32_t ms);
+	bool inInterrupt(void);
+	void setClock(uint8_t h, uint8_t m, uint8_t s);
+	void setPin(uint8_t pin, uint8_t level);
+	uint8_t getPin(uint8_t pin);
+
+	void traceStart(void);
+	void traceStop(void);
+	bool writeVcd(const char *path, const uint8_t signals[], const char *const names[], uint8_t count);
+}
+
+#endif
@@ -0,0 +1,14 @@
+/*
+	util/delay.h
+	Host stand-in. The busy waits advance the simulated clock.
+*/
+
+#ifndef _UTIL_DELAY_H_
+#define _UTIL_DELAY_H_
+
+#include <Arduino.h>
+
+#define _delay_us(us) delayMicroseconds(us)
+#define _delay_ms(ms) delay(ms)
+
+#endif
@@ -0,0 +1,89 @@
+/*
+	isr_test.cpp
+	Benchmarks the fade ISR with each of the backlight's output routines running
+	the example's colour cycle: outputByte and outputDither on the 8 bit timers,
+	and outputWide and outputHighRes on the stand in TIMER3.
+
+	The library is built with -fsanitize-coverage=trace-pc for this test only, so
+	every basic block it runs calls __sanitizer_cov_trace_pc() below. Counting
+	them from one interrupt to the next gives the work each fade tick does - the
+	same on every run, unlike timing the host - and CYCLES_PER_BLOCK turns that
+	into rough AVR cycles.
+
+	It fails if the worst tick of a routine is over its budget, which is what this
+	test measured plus some headroom, or over the flat hal::isrCycles the other
+	tests charge the fade ISR. Making the ISR slower shows up here first.
+*/
+
+#include <Arduino.h>
+#include <NixieDriver.h>
+#include <stdio.h>
+#include "hal.h"
+
+#define RUN_MS 7000 //once round the colour cycle
+#define STEP_MS 1000
+#define CYCLES_PER_BLOCK 8 //rough, for the 8 and 16 bit maths a block does on the AVR
+
+/* worst basic blocks in one fade tick - measured with g++ -O2 (49, 46, 49, 46) plus a fifth */
+#define BYTE_BUDGET 59
+#define DITHER_BUDGET 55
+#define WIDE_BUDGET 59
+#define HIGHRES_BUDGET 55
+
+static uint32_t blocks; //since the last interrupt
+static uint32_t ticks, total, worst;
+
+extern "C" void __sanitizer_cov_trace_pc(void)
+{
+	blocks++;
+}
+
+static void onInterrupt(uint8_t vector, uint64_t due, uint64_t entered)
+{
+	if(vector == hal::TIMER1_COMPA)
+	{
+		ticks++;
+		total += blocks;
+		if(blocks > worst) worst = blocks;
+	}
+	blocks = 0;
+}
+
+/* the colour cycle on rgb for RUN_MS, returning whether its worst tick is within budget */
+static bool bench(backlight *rgb, uint8_t mode, const char *name, uint32_t budget)
+{
+	int colourCycle[][4] = {{RED, STEP_MS}, {YELLOW, STEP_MS}, {GREEN, STEP_MS}, {AQUA, STEP_MS},
+							{BLUE, STEP_MS}, {MAGENTA, STEP_MS}, {PURPLE, STEP_MS}, {ENDCYCLE}};
+	rgb->setOutputMode(mode);
+	rgb->setFade(colourCycle, 0);
+
+	ticks = total = worst = 0;
+	blocks = 0;
+	hal::interruptHook = onInterrupt;
+	hal::runMs(RUN_MS);
+	hal::interruptHook = NULL;
+	rgb->stopFade(rgb->black, 0);
+	hal::runMs(10);
+
+	uint32_t worstCycles = worst * CYCLES_PER_BLOCK;
+	printf("%-14s %5u ticks, %3u blocks a tick, %3u worst (budget %u), ~%u cycles worst\n", name,
+		ticks, ticks ? total / ticks : 0, worst, budget, worstCycles);
+	return ticks && worst <= budget && worstCycles <= hal::isrCycles[hal::TIMER1_COMPA];
+}
+
+int main(void)
+{
+	bool failed = false;
+
+	/* the library keeps one backlight, the last one made */
+	backlight *eightBit = new backlight(3, 5, 6);
+	failed |= !bench(eightBit, PWM_8BIT, "outputByte", BYTE_BUDGET);
+	failed |= !bench(eightBit, PWM_HIGHRES, "outputDither", DITHER_BUDGET);
+
+	backlight *sixteenBit = new backlight(14, 15, 16);
+	failed |= !bench(sixteenBit, PWM_8BIT, "outputWide", WIDE_BUDGET);
+	failed |= !bench(sixteenBit, PWM_HIGHRES, "outputHighRes", HIGHRES_BUDGET);
+
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+/*
+	remote_test.cpp
+	Sends remote a stream of text commands and then one of binary commands over a
+	simulated serial line at 115200 baud. Bytes arrive one every 10 bit times into
+	a 64 byte receive buffer, as HardwareSerial's, and loop() calls the remote's
+	and the tubes' update() with some other work in between, as in a sketch.
+
+	For each stream it reports the commands run a second against what the line can
+	carry, and the cycles remote.update() spends on each byte. Those are the hal's
+	cycles for pins and EEPROM (a digits command shifts a frame out) plus the
+	library's own basic blocks at CYCLES_PER_BLOCK, counted as isr_test does, with
+	interrupts that run meanwhile taken out.
+
+	It fails if any command isn't answered OK or ACK, the receive buffer ever
+	overflows, the remote falls behind the line, or a stream's cycles a byte are
+	over budget - what this test measured plus some headroom.
+*/
+
+#include <Arduino.h>
+#include <NixieDriver.h>
+#include <Stream.h>
+#include <stdio.h>
+#include <vector>
+#include "hal.h"
+
+#define BAUD 115200
+#define RX_BUFFER 64 //HardwareSerial's
+#define LOOP_US 100 //the rest of the sketch's loop()
+#define REPEATS 200 //times round each stream
+#define CYCLES_PER_BLOCK 8 //as in isr_test
+#define KEEP_UP 0.95 //of the commands a second the line can carry
+#define ACK 0x06 //REMOTE_ACK, which the library keeps to itself
+
+/* sketch side cycles a byte - measured with g++ -O2 (586, 633) plus a fifth */
+#define TEXT_BUDGET 700
+#define BINARY_BUDGET 760
+
+/* a serial line into the receive buffer, and whatever is written back */
+class SerialLine : public Stream
+{
+	public:
+		std::vector<uint8_t> wire; //bytes to send, in order
+		std::vector<uint8_t> replies;
+		uint64_t start; //the first byte's start bit
+		uint64_t lastReply;
+		uint32_t overflows;
+
+		void send(uint64_t at)
+		{
+			start = at;
+			sent = 0;
+			head = tail = 0;
+			overflows = 0;
+			replies.clear();
+		}
+
+		/* the cycle the byte's stop bit ends */
+		uint64_t arrival(size_t byte)
+		{
+			return start + (uint64_t)(byte + 1) * 10 * F_CPU / BAUD;
+		}
+
+		bool done(void)
+		{
+			return sent == wire.size() && head == tail;
+		}
+
+		int available(void)
+		{
+			/* nothing reads the buffer between polls, so taking them in now is as the receive interrupt would */
+			while(sent < wire.size() && arrival(sent) <= hal::cycles)
+			{
+				if(head - tail < RX_BUFFER) buffer[head++ % RX_BUFFER] = wire[sent];
+				else overflows++;
+				sent++;
+			}
+			return head - tail;
+		}
+
+		int read(void)
+		{
+			if(!available()) return -1;
+			return buffer[tail++ % RX_BUFFER];
+		}
+
+		size_t write(uint8_t c)
+		{
+			replies.push_back(c);
+			lastReply = hal::cycles;
+			return 1;
+		}
+
+	private:
+		size_t sent;
+		uint8_t buffer[RX_BUFFER];
+		uint32_t head, tail;
+};
+
+nixie tubes(8, 9, 10);
+backlight backlit(3, 5, 6);
+SerialLine line;
+remote port(&line, &tubes, &backlit);
+
+static uint32_t blocks; //the library's, outside interrupts
+static uint64_t isrTime; //cycles spent in interrupts
+
+extern "C" void __sanitizer_cov_trace_pc(void)
+{
+	if(!hal::inInterrupt()) blocks++;
+}
+
+static void onInterrupt(uint8_t vector, uint64_t due, uint64_t entered)
+{
+	isrTime += hal::cycles - entered;
+}
+
+static void addText(const char *command)
+{
+	while(*command) line.wire.push_back(*command++);
+}
+
+static void addBinary(uint8_t command, const uint8_t payload[], uint8_t length)
+{
+	uint8_t check = command ^ length;
+	line.wire.push_back(command);
+	line.wire.push_back(length);
+	for(uint8_t i = 0; i < length; i++)
+	{
+		line.wire.push_back(payload[i]);
+		check ^= payload[i];
+	}
+	line.wire.push_back(check);
+}
+
+/* the stream in line.wire through loop(), returning whether it kept to the budget */
+static bool run(const char *name, uint32_t commands, uint32_t answers, uint32_t budget)
+{
+	line.send(hal::cycles);
+	blocks = 0;
+	isrTime = 0;
+	uint64_t spent = 0; //in remote.update(), less interrupts
+
+	hal::interruptHook = onInterrupt;
+	while(!line.done())
+	{
+		uint64_t from = hal::cycles, isrFrom = isrTime;
+		port.update();
+		spent += (hal::cycles - from) - (isrTime - isrFrom);
+		tubes.update();
+		hal::run(hal::cycles + LOOP_US * clockCyclesPerMicrosecond());
+	}
+	hal::interruptHook = NULL;
+
+	uint64_t updateCycles = spent + (uint64_t)blocks * CYCLES_PER_BLOCK;
+
+	uint32_t answered = 0;
+	for(size_t i = 0; i < line.replies.size(); i++)
+		answered += (line.replies[i] == answers);
+
+	double seconds = (line.lastReply - line.start) / (double)F_CPU;
+	double rate = commands / seconds;
+	double lineRate = commands * (double)BAUD / (10.0 * line.wire.size());
+	uint32_t perByte = updateCycles / line.wire.size();
+	printf("%-6s %u commands, %u bytes: %.0f commands/s (line %.0f), %u cycles a byte (budget %u), %u overflowed\n",
+		name, commands, (uint32_t)line.wire.size(), rate, lineRate, perByte, budget, line.overflows);
+
+	line.wire.clear();
+	return answered == commands && !line.overflows && rate >= lineRate * KEEP_UP && perByte <= budget;
+}
+
+int main(void)
+{
+	bool failed = false;
+
+	tubes.setSegment(4, IN15A);
+
+	/* text, answered with OK\r\n */
+	for(uint16_t i = 0; i < REPEATS; i++)
+	{
+		addText("D123456\n");
+		addText("N-12.5\n");
+		addText("P010100\n");
+		addText("S4,7\n");
+		addText("T12:34:56\n");
+		addText("C255,0,100\n");
+	}
+	failed |= !run("text", REPEATS * 6, 'K', TEXT_BUDGET);
+
+	/* binary, answered with an ACK byte */
+	const uint8_t digits[] = {6, 5, 4, 3, 2, 1};
+	const uint8_t frame[] = {0x01, 0x00, 0x02, 0x00, 0x04, 0x00, 0x08, 0x00, 0x10, 0x00, 0x20, 0x00, 0x05};
+	const uint8_t points[] = {0x15};
+	const uint8_t time[] = {23, 59, 30};
+	const uint8_t colour[] = {0, 128, 255};
+	for(uint16_t i = 0; i < REPEATS; i++)
+	{
+		addBinary(REMOTE_DIGITS, digits, sizeof(digits));
+		addBinary(REMOTE_FRAME, frame, sizeof(frame));
+		addBinary(REMOTE_POINTS, points, sizeof(points));
+		addBinary(REMOTE_TIME, time, sizeof(time));
+		addBinary(REMOTE_COLOUR, colour, sizeof(colour));
+	}
+	failed |= !run("binary", REPEATS * 5, ACK, BINARY_BUDGET);
+
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
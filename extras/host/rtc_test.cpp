@@ -0,0 +1,172 @@
+/*
+	rtc_test.cpp
+	Runs rtc against the hal's DS3231 and DS1307 on the TWI bus, with the chip's
+	1Hz square wave on INT0 (pin 2), and checks:
+
+		- each falling edge is followed by a clean read, putting the chip's time on
+		  the tubes within READ_BUDGET_MS and marking it valid and synced
+		- a chip that doesn't acknowledge its address, or a bus error, leaves the
+		  tubes alone, and the read is tried again until it works
+		- 23:59:58 written by setTime() goes over the minute and hour to 00:00:00
+
+	The library is built with -fsanitize-coverage=trace-pc, as for isr_test, and
+	the basic blocks of each shared tick are counted. The worst tick while the rtc
+	is reading, less the worst before begin() with the tick running alone, is what
+	rtc::tick() adds - the square wave's handler counted in with the tick after it.
+	It fails if that is over TICK_BUDGET, which is what this test measured plus
+	some headroom.
+*/
+
+#include <Arduino.h>
+#include <NixieDriver.h>
+#include <stdio.h>
+#include "hal.h"
+
+#define SQW_PIN 2
+#define CYCLES_PER_BLOCK 8 //as in isr_test
+
+/* measured with g++ -O2 (10ms, 22 blocks) plus a fifth */
+#define READ_BUDGET_MS 12
+#define TICK_BUDGET 26
+
+nixie tubes(8, 9, 10);
+
+static uint32_t blocks; //since the last shared tick
+static uint32_t worst;
+static uint32_t edges;
+static uint64_t edgeAt;
+
+extern "C" void __sanitizer_cov_trace_pc(void)
+{
+	blocks++;
+}
+
+static void onInterrupt(uint8_t vector, uint64_t due, uint64_t entered)
+{
+	if(vector != hal::TIMER0_COMPA) return;
+	if(blocks > worst) worst = blocks;
+	blocks = 0;
+}
+
+static void onPin(uint8_t pin, uint8_t level)
+{
+	if(pin != SQW_PIN || level != LOW) return;
+	edges++;
+	edgeAt = hal::cycles;
+}
+
+static uint8_t fromBcd(uint8_t bcd)
+{
+	return (bcd >> 4) * 10 + (bcd & 0x0F);
+}
+
+/* whether the tubes show the chip's time */
+static bool showsChip(void)
+{
+	return tubes.hours == fromBcd(hal::clockChip.registers[2] & 0x3F) &&
+		   tubes.minutes == fromBcd(hal::clockChip.registers[1]) &&
+		   tubes.seconds == fromBcd(hal::clockChip.registers[0] & 0x7F);
+}
+
+/* up to the next falling edge of the square wave */
+static void nextEdge(void)
+{
+	uint32_t seen = edges;
+	while(edges == seen) hal::step(hal::NEVER);
+}
+
+/* ms from the last edge until the tubes show the chip's time, or -1 if not within the budget */
+static int32_t readTime(void)
+{
+	while(hal::cycles < edgeAt + (uint64_t)READ_BUDGET_MS * hal::CYCLES_PER_MS)
+	{
+		if(showsChip()) return (hal::cycles - edgeAt) / hal::CYCLES_PER_MS;
+		hal::runMs(1);
+	}
+	return showsChip() ? READ_BUDGET_MS : -1;
+}
+
+/* the next few seconds, returning whether each was read clean */
+static bool clean(rtc *clock, const char *name, uint8_t seconds)
+{
+	int32_t slowest = 0;
+	bool ok = true;
+	for(uint8_t i = 0; i < seconds; i++)
+	{
+		nextEdge();
+		int32_t ms = readTime();
+		if(ms < 0) ok = false;
+		if(ms > slowest) slowest = ms;
+	}
+	ok = ok && clock->isValid() && tubes.isTimeSynced();
+	printf("%-9s %u seconds read, slowest %dms after the edge (budget %d), %02u:%02u:%02u%s\n", name, seconds,
+		ok ? slowest : -1, READ_BUDGET_MS, tubes.hours, tubes.minutes, tubes.seconds, ok ? "" : " - wrong");
+	return ok;
+}
+
+/* a second where the bus fails, returning whether the tubes waited or the errors were met, then caught up */
+static bool failing(const char *name, bool absent, uint8_t busErrors)
+{
+	uint8_t h = tubes.hours, m = tubes.minutes, s = tubes.seconds;
+	hal::clockChip.present = !absent;
+	hal::clockChip.busErrors = busErrors;
+	nextEdge();
+	hal::runMs(READ_BUDGET_MS);
+	bool waited = absent ? (tubes.hours == h && tubes.minutes == m && tubes.seconds == s) : !hal::clockChip.busErrors;
+
+	hal::clockChip.present = true;
+	hal::runMs(READ_BUDGET_MS);
+	bool caught = showsChip();
+	printf("%-9s %s, %s\n", name, absent ? (waited ? "tubes left alone" : "tubes changed") :
+		(waited ? "errors met" : "errors not met"), caught ? "then read" : "never read");
+	return waited && caught;
+}
+
+int main(void)
+{
+	bool failed = false;
+
+	/* the shared tick on its own */
+	TIMSK0 |= (1 << OCIE0A);
+	blocks = 0;
+	hal::interruptHook = onInterrupt;
+	hal::runMs(1000);
+	uint32_t baseline = worst;
+
+	/* a DS3231 */
+	hal::pinHook = onPin;
+	hal::clockChip.sqwPin = SQW_PIN;
+	hal::setClock(12, 34, 56);
+	rtc *clock = new rtc(&tubes, SQW_PIN);
+	worst = 0;
+	clock->begin();
+	failed |= !clean(clock, "DS3231", 5);
+	failed |= !failing("NACK", true, 0);
+	failed |= !failing("bus error", false, 1);
+	failed |= !failing("3 errors", false, 3);
+
+	/* over the minute and hour */
+	while(!clock->setTime(23, 59, 58)) hal::runMs(1);
+	failed |= !clean(clock, "rollover", 2);
+	failed |= tubes.hours || tubes.minutes || tubes.seconds;
+	uint32_t reading = worst;
+
+	/* a DS1307 - the library keeps one rtc, the last begun */
+	hal::clockChip.ds1307 = true;
+	hal::setClock(9, 59, 59);
+	clock = new rtc(&tubes, SQW_PIN, RTC_DS1307);
+	clock->begin();
+	failed |= !clean(clock, "DS1307", 2);
+	failed |= hal::clockChip.registers[0x07] != 0x10;
+	if(worst > reading) reading = worst;
+	hal::interruptHook = NULL;
+
+	uint32_t cost = reading - baseline;
+	printf("shared tick: %u blocks worst alone, %u while reading\n", baseline, reading);
+	printf("rtc::tick() adds %u blocks to the worst tick (budget %u), ~%u cycles, %u reads\n", cost,
+		TICK_BUDGET, cost * CYCLES_PER_BLOCK, hal::clockChip.reads);
+	failed |= cost > TICK_BUDGET;
+
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+/*
+	soak_test.cpp
+	Calls setFade() and stopFade() 200,000 times with random fades, running the
+	simulated chip for up to 2ms between calls so the fade interrupt swaps in,
+	steps through and retires what they built. A third of the setFade() calls
+	have malloc() fail part way through the loop.
+
+	malloc() and free() are wrapped at link time to keep every block the library
+	holds. It fails if a block is freed that it doesn't hold, if anything is left
+	once the fade is stopped, or if it ever holds more than three whole fades -
+	the running one, one waiting for the end of its step and the one setFade()
+	is building to replace the waiting one.
+*/
+
+#include <Arduino.h>
+#include <NixieDriver.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include "hal.h"
+
+#define CYCLES 200000L
+#define MAX_STEPS 12
+#define PROGRAM_NODES (MAX_STEPS + 2) //the steps, the fade in and the entry node
+#define PEAK_BUDGET (3 * PROGRAM_NODES) //running, waiting and being built
+
+extern "C" void *__real_malloc(size_t size);
+extern "C" void __real_free(void *block);
+
+backlight backlit(3, 5, 6);
+
+static std::map<void *, size_t> *held; //blocks the library holds, while counting
+static size_t heldBytes, peakBytes, peakBlocks;
+static uint32_t badFrees;
+static int failEvery, calls; //every failEvery'th malloc() fails, 0 for none
+
+extern "C" void *__wrap_malloc(size_t size)
+{
+	if(failEvery && ++calls % failEvery == 0) return NULL;
+	void *block = __real_malloc(size);
+	if(held != NULL && block != NULL)
+	{
+		(*held)[block] = size;
+		heldBytes += size;
+		if(heldBytes > peakBytes) peakBytes = heldBytes;
+		if(held->size() > peakBlocks) peakBlocks = held->size();
+	}
+	return block;
+}
+
+extern "C" void __wrap_free(void *block)
+{
+	if(held != NULL && block != NULL)
+	{
+		std::map<void *, size_t>::iterator it = held->find(block);
+		if(it == held->end())
+		{
+			badFrees++;
+			return;
+		}
+		heldBytes -= it->second;
+		held->erase(it);
+	}
+	__real_free(block);
+}
+
+int main(void)
+{
+	static std::map<void *, size_t> blocks;
+	int setup[MAX_STEPS + 1][4];
+	uint32_t failedSets = 0;
+
+	held = &blocks;
+	srand(1);
+	for(long i = 0; i < CYCLES; i++)
+	{
+		int steps = 1 + rand() % MAX_STEPS;
+		for(int s = 0; s < steps; s++)
+		{
+			setup[s][0] = rand() % 256;
+			setup[s][1] = rand() % 256;
+			setup[s][2] = rand() % 256;
+			setup[s][3] = 1 + rand() % 1000;
+		}
+		setup[steps][0] = setup[steps][1] = setup[steps][2] = setup[steps][3] = 0;
+
+		failEvery = (rand() % 3 == 0) ? 1 + rand() % 8 : 0;
+		calls = 0;
+		if(!backlit.setFade(setup, rand() % 20)) failedSets++;
+		failEvery = 0;
+		hal::run(hal::cycles + rand() % (2 * hal::CYCLES_PER_MS));
+
+		if(rand() % 2)
+		{
+			backlit.stopFade(backlit.black, rand() % 3);
+			hal::run(hal::cycles + rand() % (2 * hal::CYCLES_PER_MS));
+		}
+	}
+	backlit.stopFade(backlit.black, 0);
+	hal::runMs(10);
+	backlit.stopFade(backlit.black, 0); //frees what the last one left for the ISR
+
+	bool failed = blocks.size() || badFrees || peakBlocks > PEAK_BUDGET;
+	printf("%ld cycles, %u setFade() failed for memory\n", CYCLES, failedSets);
+	printf("%zu blocks (%zu bytes) left, %u bad frees\n", blocks.size(), heldBytes, badFrees);
+	printf("peak %zu blocks (%zu bytes), budget %d blocks\n", peakBlocks, peakBytes, PEAK_BUDGET);
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+/*
+	trace_test.cpp
+	Runs the example's set up - a clock on the tubes and the colour cycle on the
+	backlight - with the stopwatch showing a frame every 10ms, shifted out by
+	update() from a loop as in a sketch, traces the driver's pins and both
+	interrupts for 5s, and measures from the trace:
+
+		dark time	- how long output enable is low for each frame
+		bit rate	- the clock pulses shifted out while dark, over the dark time
+		jitter		- how far each fade ISR lands from a step's period after the last
+		latency		- how long each shared tick waits after its compare, which moves
+					  with the duty of the LED on OCR0A
+		duty		- each LED's PWM duty register: how often it changes, by how
+					  much at once, and whether anything but the fade ISR writes it
+
+	It fails if a frame isn't exactly 68 bits shifted while dark, or a figure is
+	over its budget. Neither interrupt ever shifts a frame, so each is only held
+	off by the other. The trace is saved to build/trace.vcd for a waveform viewer.
+*/
+
+#include <Arduino.h>
+#include <NixieDriver.h>
+#include <stdio.h>
+#include "hal.h"
+
+#define DATA_PIN 8
+#define CLOCK_PIN 9
+#define OE_PIN 10
+
+#define FRAME_BITS 68
+#define DARK_BUDGET_US 1000 //a frame's shift(), see its Desc
+#define MIN_BITS_PER_SECOND 68000 //a frame within the dark budget
+#define FADE_JITTER_BUDGET_US 20 //held off by one shared tick at most, which never shifts
+#define TICK_LATENCY_BUDGET_US 50 //held off by one fade ISR at most
+#define DUTY_STEP_BUDGET 3 //most a duty moves in one fade tick of a 1s step
+
+#define TRACE_MS 5000
+#define LOOP_US 100 //the rest of the sketch's loop()
+#define STEP_MS 1000
+
+nixie tubes(DATA_PIN, CLOCK_PIN, OE_PIN);
+backlight backlit(3, 5, 6);
+
+/* loop() for ms, calling update() */
+static void runLoop(uint32_t ms)
+{
+	uint64_t end = hal::cycles + (uint64_t)ms * hal::CYCLES_PER_MS;
+	while(hal::cycles < end)
+	{
+		tubes.update();
+		hal::run(hal::cycles + LOOP_US * clockCyclesPerMicrosecond());
+	}
+}
+
+static double us(uint64_t cycles)
+{
+	return cycles * 1000000.0 / F_CPU;
+}
+
+static uint64_t tickLatency;
+
+static void onInterrupt(uint8_t vector, uint64_t due, uint64_t entered)
+{
+	if(vector == hal::TIMER0_COMPA && entered - due > tickLatency) tickLatency = entered - due;
+}
+
+/* worst distance of the rising edges of signal from period apart */
+static uint64_t jitter(uint8_t signal, uint64_t period, uint32_t *edges)
+{
+	uint64_t last = 0, worst = 0;
+	*edges = 0;
+	for(size_t i = 0; i < hal::traceEvents.size(); i++)
+	{
+		const hal::TraceEvent_t &event = hal::traceEvents[i];
+		if(event.signal != signal || !event.level) continue;
+		if((*edges)++)
+		{
+			uint64_t interval = event.at - last;
+			uint64_t off = (interval > period) ? interval - period : period - interval;
+			if(off > worst) worst = off;
+		}
+		last = event.at;
+	}
+	return worst;
+}
+
+/* changes to a register after its first value, the largest, and how many weren't in the fade ISR */
+static uint32_t dutyUpdates(uint8_t reg, uint16_t *largest, uint32_t *outside)
+{
+	uint32_t updates = 0;
+	bool first = true, inFade = false;
+	uint16_t last = 0;
+	*largest = 0;
+	*outside = 0;
+	for(size_t i = 0; i < hal::traceEvents.size(); i++)
+	{
+		const hal::TraceEvent_t &event = hal::traceEvents[i];
+		if(event.signal == hal::TRACE_ISR + hal::TIMER1_COMPA) inFade = event.level;
+		if(event.signal != hal::TRACE_REG + reg) continue;
+		if(!first)
+		{
+			uint16_t step = (event.level > last) ? event.level - last : last - event.level;
+			if(step > *largest) *largest = step;
+			if(!inFade) (*outside)++;
+			updates++;
+		}
+		first = false;
+		last = event.level;
+	}
+	return updates;
+}
+
+int main(void)
+{
+	bool failed = false;
+
+	int colourCycle[][4] = {{RED, STEP_MS}, {YELLOW, STEP_MS}, {GREEN, STEP_MS}, {AQUA, STEP_MS},
+							{BLUE, STEP_MS}, {MAGENTA, STEP_MS}, {PURPLE, STEP_MS}, {ENDCYCLE}};
+	backlit.setFade(colourCycle, 0);
+	tubes.startStopwatch();
+	runLoop(100); //past the fade in
+
+	hal::interruptHook = onInterrupt;
+	hal::traceStart();
+	runLoop(TRACE_MS);
+	hal::traceStop();
+	hal::interruptHook = NULL;
+
+	/* frames: each output enable low to high */
+	uint32_t frames = 0, bits = 0, badFrames = 0, litBits = 0;
+	uint64_t darkFrom = 0, darkTotal = 0, darkWorst = 0;
+	double slowest = 0;
+	bool dark = false;
+	for(size_t i = 0; i < hal::traceEvents.size(); i++)
+	{
+		const hal::TraceEvent_t &event = hal::traceEvents[i];
+		if(event.signal == OE_PIN && !event.level)
+		{
+			dark = true;
+			darkFrom = event.at;
+			bits = 0;
+		}
+		else if(event.signal == OE_PIN && event.level && dark)
+		{
+			dark = false;
+			uint64_t length = event.at - darkFrom;
+			darkTotal += length;
+			if(length > darkWorst) darkWorst = length;
+			double rate = bits / (us(length) / 1000000.0);
+			if(!frames || rate < slowest) slowest = rate;
+			if(bits != FRAME_BITS) badFrames++;
+			frames++;
+		}
+		else if(event.signal == CLOCK_PIN && event.level)
+		{
+			if(dark) bits++;
+			else litBits++;
+		}
+	}
+
+	uint32_t fadeTicks, tubeTicks;
+	uint64_t fadeJitter = jitter(hal::TRACE_ISR + hal::TIMER1_COMPA, (uint64_t)STEP_MS * hal::CYCLES_PER_MS / FADE_RESOLUTION, &fadeTicks);
+	jitter(hal::TRACE_ISR + hal::TIMER0_COMPA, 256 * 64, &tubeTicks);
+
+	printf("%u frames, dark %.0fus worst, %.1f%% of the time\n", frames, us(darkWorst),
+		100.0 * darkTotal / ((uint64_t)TRACE_MS * hal::CYCLES_PER_MS));
+	printf("%.0f bits/s slowest, %u frames not %d bits, %u bits while lit\n", slowest, badFrames,
+		FRAME_BITS, litBits);
+	printf("fade ISR %u times, jitter %.1fus\n", fadeTicks, us(fadeJitter));
+	printf("tick ISR %u times, latency %.1fus worst\n", tubeTicks, us(tickLatency));
+
+	failed |= frames < TRACE_MS / 10 - 1 || badFrames || litBits;
+	failed |= us(darkWorst) > DARK_BUDGET_US;
+	failed |= slowest < MIN_BITS_PER_SECOND;
+	failed |= us(fadeJitter) > FADE_JITTER_BUDGET_US;
+	failed |= us(tickLatency) > TICK_LATENCY_BUDGET_US;
+	failed |= tubeTicks < (uint64_t)TRACE_MS * hal::CYCLES_PER_MS / (256 * 64) - 1; //none lost
+
+	/* the backlight on pins 3, 5 and 6 */
+	const uint8_t duties[] = {hal::REG_OCR2B, hal::REG_OCR0B, hal::REG_OCR0A};
+	const char *const leds[] = {"red", "green", "blue"};
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		uint16_t largest;
+		uint32_t outside;
+		uint32_t updates = dutyUpdates(duties[i], &largest, &outside);
+		printf("%s duty %u updates, %u at most, %u outside the fade ISR\n", leds[i], updates, largest, outside);
+		failed |= !updates || updates > fadeTicks || outside || largest > DUTY_STEP_BUDGET;
+	}
+
+	const uint8_t signals[] = {DATA_PIN, CLOCK_PIN, OE_PIN,
+							   hal::TRACE_ISR + hal::TIMER1_COMPA, hal::TRACE_ISR + hal::TIMER0_COMPA,
+							   hal::TRACE_REG + hal::REG_OCR2B, hal::TRACE_REG + hal::REG_OCR0B,
+							   hal::TRACE_REG + hal::REG_OCR0A, hal::TRACE_REG + hal::REG_OCR1A};
+	const char *const names[] = {"data", "clock", "oe", "fade_isr", "tick_isr",
+								 "red_duty", "green_duty", "blue_duty", "fade_top"};
+	if(!hal::writeVcd("build/trace.vcd", signals, names, 9))
+	{
+		printf("couldn't write build/trace.vcd\n");
+		failed = true;
+	}
+
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+/*
+	usage_test.cpp
+	Leaves a number on the tubes for an hour and a bit, then runs the stopwatch for
+	another, calling update() from the loop as a sketch would. Checks the static
+	number is counted even though nothing is shifted out, that each hour's flush
+	reaches the EEPROM log, and that none of it is written from an interrupt while
+	the stopwatch has update() shifting a frame from the tick every 10ms.
+*/
+
+#include <Arduino.h>
+#include <NixieDriver.h>
+#include <stdio.h>
+#include "hal.h"
+
+#define LOOP_MS 10
+#define STATIC_S 3700
+#define WATCH_S 3700
+
+nixie tubes(8, 9, 10);
+
+static void runFor(uint32_t seconds)
+{
+	uint64_t end = hal::cycles + (uint64_t)seconds * 1000 * hal::CYCLES_PER_MS;
+	while(hal::cycles < end) //update() takes time of its own to shift a frame
+	{
+		uint64_t next = hal::cycles + LOOP_MS * hal::CYCLES_PER_MS;
+		hal::run(next < end ? next : end);
+		tubes.update();
+	}
+}
+
+/* hours in the newest complete copy of the log, as flushes write them */
+static uint32_t loggedHours(uint8_t tube, uint8_t digit)
+{
+	tubes.setUsageTracking(false);
+	tubes.setUsageTracking(true); //starts again from the EEPROM
+	return tubes.getUsage(tube, digit) / 3600;
+}
+
+int main(void)
+{
+	bool failed = false;
+
+	tubes.setUsageTracking(true);
+	tubes.displayDigits(1, 2, 3, 4, 5, 6);
+	runFor(STATIC_S);
+
+	uint32_t lit = tubes.getUsage(0, 1);
+	uint32_t dark = tubes.getUsage(0, 2);
+	printf("static number for %ds: tube 0 digit 1 lit %us, digit 2 %us\n", STATIC_S, lit, dark);
+	failed |= lit < STATIC_S - 1 || lit > STATIC_S || dark;
+
+	uint32_t hours = loggedHours(0, 1);
+	printf("logged %u hour(s) after the first flush\n", hours);
+	failed |= hours != 1;
+
+	/* the stopwatch has the tubes, posted by the tick */
+	uint32_t hundredths = 0;
+	for(uint8_t digit = 0; digit < 10; digit++)
+		hundredths -= tubes.getUsage(5, digit);
+	tubes.startStopwatch();
+	runFor(WATCH_S);
+	tubes.endStopwatch();
+	for(uint8_t digit = 0; digit < 10; digit++)
+		hundredths += tubes.getUsage(5, digit);
+	printf("stopwatch for %ds: hundredths tube lit %us over all digits\n", WATCH_S, hundredths);
+	failed |= hundredths < WATCH_S * 9 / 10 || hundredths > WATCH_S; //less the dark time of each frame
+
+	printf("%u EEPROM bytes written from an interrupt\n", hal::isrEepromWrites);
+	failed |= hal::isrEepromWrites != 0;
+
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Size budget for the example sketch on an Uno.
+#
+#	extras/size/budget.sh [sketch.elf]
+#
+# Builds Examples/Clock_with_button_adjustment with arduino-cli, or takes an ELF
+# built some other way, reports .text, .data and .bss from avr-size, and fails if
+# flash (.text + .data) or RAM (.data + .bss) is over budget. The budgets are the
+# Uno's flash less the bootloader, and its RAM less 512 bytes for the stack and the
+# fade nodes on the heap. FLASH_BUDGET, RAM_BUDGET and FQBN override them.
+
+set -e
+cd "$(dirname "$0")/../.."
+
+FLASH_BUDGET=${FLASH_BUDGET:-32256}
+RAM_BUDGET=${RAM_BUDGET:-1536}
+FQBN=${FQBN:-arduino:avr:uno}
+SKETCH=Examples/Clock_with_button_adjustment
+BUILD=extras/size/build
+
+if [ $# -gt 0 ]; then
+	ELF=$1
+else
+	arduino-cli compile --fqbn "$FQBN" --library . --build-path "$BUILD" "$SKETCH" > /dev/null
+	ELF=$BUILD/$(basename "$SKETCH").ino.elf
+fi
+
+avr-size -A "$ELF" | awk -v flashBudget="$FLASH_BUDGET" -v ramBudget="$RAM_BUDGET" '
+	$1 == ".text" { text = $2 }
+	$1 == ".data" { data = $2 }
+	$1 == ".bss"  { bss = $2 }
+	END {
+		flash = text + data
+		ram = data + bss
+		printf ".text %6d\n.data %6d\n.bss  %6d\n", text, data, bss
+		printf "flash %6d of %d\nram   %6d of %d\n", flash, flashBudget, ram, ramBudget
+		if (flash > flashBudget || ram > ramBudget) {
+			print "OVER BUDGET"
+			exit 1
+		}
+	}'
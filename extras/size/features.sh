@@ -0,0 +1,47 @@
+#!/bin/sh
+# Flash and RAM each feature costs a sketch.
+#
+#	extras/size/features.sh SIZE DIR BUDGETS
+#
+# Takes <sketch>.elf in DIR for each of sketches/, reports its .text, .data and
+# .bss from SIZE (size or avr-size) over those of bare.elf, and fails if any is
+# over its line in BUDGETS - "sketch text data bss", each the most that sketch may
+# add. A sketch with no line is only reported.
+
+set -e
+
+SIZE=$1
+DIR=$2
+BUDGETS=$3
+
+for elf in "$DIR"/*.elf; do
+	"$SIZE" "$elf" | awk -v name="$(basename "$elf" .elf)" 'NR == 2 { print name, $1, $2, $3 }'
+done | awk -v budgets="$BUDGETS" '
+	BEGIN {
+		while ((getline line < budgets) > 0) {
+			if (split(line, f) == 4 && f[1] !~ /^#/) {
+				budgeted[f[1]] = 1
+				textBudget[f[1]] = f[2]; dataBudget[f[1]] = f[3]; bssBudget[f[1]] = f[4]
+			}
+		}
+	}
+	{ sketch[++n] = $1; text[$1] = $2; data[$1] = $3; bss[$1] = $4 }
+	END {
+		if (!("bare" in text)) { print "no bare sketch to measure against"; exit 1 }
+		printf "%-10s %7s %7s %7s   over bare (budget)\n", "sketch", ".text", ".data", ".bss"
+		over = 0
+		for (i = 1; i <= n; i++) {
+			s = sketch[i]
+			if (s == "bare") continue
+			t = text[s] - text["bare"]; d = data[s] - data["bare"]; b = bss[s] - bss["bare"]
+			if (s in budgeted) {
+				status = sprintf("(%d %d %d)", textBudget[s], dataBudget[s], bssBudget[s])
+				if (t > textBudget[s] || d > dataBudget[s] || b > bssBudget[s]) { status = status " OVER BUDGET"; over = 1 }
+			}
+			else
+				status = "(no budget)"
+			printf "%-10s %+7d %+7d %+7d   %s\n", s, t, d, b, status
+		}
+		printf "%-10s %7d %7d %7d   itself\n", "bare", text["bare"], data["bare"], bss["bare"]
+		exit over
+	}'
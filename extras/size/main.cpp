@@ -0,0 +1,21 @@
+/*
+	main.cpp
+	The Arduino core's main(), for the sketches built on the host. They are only
+	linked to be measured, never run. Stepping the hal links in the ISRs, as the
+	vector table does on the AVR, so bare has them too.
+*/
+
+#include "hal.h"
+
+void setup(void);
+void loop(void);
+
+int main(void)
+{
+	setup();
+	for(;;)
+	{
+		loop();
+		hal::step(hal::NEVER);
+	}
+}
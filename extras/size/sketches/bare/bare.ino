@@ -0,0 +1,12 @@
+/*
+	bare.ino
+	Nothing but the library linked in - what each feature's sketch is measured against.
+*/
+
+#include <NixieDriver.h>
+
+void setup() {
+}
+
+void loop() {
+}
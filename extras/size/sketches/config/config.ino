@@ -0,0 +1,16 @@
+/*
+	config.ino
+	The display put back from EEPROM at power up, and saved again.
+*/
+
+#include <NixieDriver.h>
+
+nixie tubes(8, 9, 10);
+
+void setup() {
+  if(!tubes.restoreConfig()) tubes.saveConfig();
+}
+
+void loop() {
+  tubes.update();
+}
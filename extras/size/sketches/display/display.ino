@@ -0,0 +1,16 @@
+/*
+	display.ino
+	The core display: a number shifted out to the tubes.
+*/
+
+#include <NixieDriver.h>
+
+nixie tubes(8, 9, 10);
+
+void setup() {
+  tubes.display(123456L);
+}
+
+void loop() {
+  tubes.update();
+}
@@ -0,0 +1,18 @@
+/*
+	fades.ino
+	A backlight colour cycle faded in the background.
+*/
+
+#include <NixieDriver.h>
+
+backlight rgb(3, 5, 6);
+
+int colourCycle[][4] = {{RED, 1000}, {GREEN, 1000}, {BLUE, 1000}, {ENDCYCLE}};
+
+void setup() {
+  rgb.setFade(colourCycle, 1000);
+}
+
+void loop() {
+  rgb.update();
+}
@@ -0,0 +1,19 @@
+/*
+	remote.ino
+	The tubes and backlight driven by commands over Serial.
+*/
+
+#include <NixieDriver.h>
+
+nixie tubes(8, 9, 10);
+backlight rgb(3, 5, 6);
+remote port(&Serial, &tubes, &rgb);
+
+void setup() {
+  Serial.begin(115200);
+}
+
+void loop() {
+  port.update();
+  tubes.update();
+}
@@ -0,0 +1,18 @@
+/*
+	rtc.ino
+	The time kept from a DS3231 with its square wave on pin 2.
+*/
+
+#include <NixieDriver.h>
+
+nixie tubes(8, 9, 10);
+rtc clock(&tubes, 2);
+
+void setup() {
+  tubes.setClockMode(1);
+  clock.begin();
+}
+
+void loop() {
+  tubes.update();
+}
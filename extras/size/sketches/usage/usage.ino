@@ -0,0 +1,17 @@
+/*
+	usage.ino
+	Cathode usage counted and logged to EEPROM.
+*/
+
+#include <NixieDriver.h>
+
+nixie tubes(8, 9, 10);
+
+void setup() {
+  tubes.setUsageTracking(1);
+  tubes.display(123456L);
+}
+
+void loop() {
+  tubes.update();
+}